@@ -0,0 +1,621 @@
+/**
+ * @file file_path_benchmark.cpp
+ * @brief FilePath の主要な操作 (解析, 連結, 文字列化, ディレクトリ走査, stat) のベンチマーク
+ *
+ * C++17 以降でビルドした場合は、同じ操作を std::filesystem で行うケース (BM_Std*) も登録し、
+ * 同名のケース同士 (BM_Parse と BM_StdParse など) を比較できるようにする。
+ * ディレクトリ走査と stat のケースは FILE_PATH_BENCHMARK_DIR (未設定の場合は /tmp/file_path_benchmark) の下に
+ * 1000 件ずつのディレクトリに分けた合成の木 (10k / 1M エントリ) を初回のみ作成し、以降の実行では再利用する。
+ *
+ * ビルド例:
+ *   g++ -std=c++11 -O2 -I.. file_path_benchmark.cpp -lbenchmark -lpthread -o file_path_benchmark
+ *   g++ -std=c++17 -O2 -I.. file_path_benchmark.cpp -lbenchmark -lpthread -o file_path_benchmark_std
+ *
+ * 実行例:
+ *   ./file_path_benchmark_std --benchmark_filter='Parse|Join|ToStr|ParentPath'
+ *   ./file_path_benchmark_std --benchmark_filter='DirectoryIterator/10000'
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "file_path.hpp"
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<filesystem>)
+#include <filesystem>
+#define FILE_PATH_BENCHMARK_HAS_STD_FILESYSTEM 1
+#endif
+#endif
+
+namespace
+{
+
+const std::size_t ENTRIES_PER_DIRECTORY = 1000;
+
+std::vector<std::string> make_manifest(std::size_t count)
+{
+    static const char* const roots[] = { "/data/tenant", "/var/spool/ingest", "/mnt/nvme0/warehouse/events" };
+    std::vector<std::string> result;
+    result.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::string path = roots[i % 3];
+        path += "/2026/10/" + std::to_string(i % 31) + "/shard-" + std::to_string(i % 977);
+        path += "/part-" + std::to_string(i) + ".parquet";
+        result.push_back(path);
+    }
+    return result;
+}
+
+const std::vector<std::string>& manifest()
+{
+    static const std::vector<std::string> paths = make_manifest(4096);
+    return paths;
+}
+
+const std::vector<FilePath>& manifest_paths()
+{
+    static const std::vector<FilePath> paths(manifest().begin(), manifest().end());
+    return paths;
+}
+
+FilePath benchmark_directory()
+{
+    const char* directory = std::getenv("FILE_PATH_BENCHMARK_DIR");
+    if (directory != NULL && *directory != '\0')
+        return FilePath(directory);
+#ifdef __unix__
+    return FilePath("/tmp/file_path_benchmark");
+#else
+    return FilePath::current_path() / FilePath("file_path_benchmark");
+#endif
+}
+
+/**
+ * @brief entries 件の空ファイルを ENTRIES_PER_DIRECTORY 件ずつのディレクトリに分けた木を返す
+ *
+ * 作成を終えた木には隣に完了マーカーを置き、次回以降の実行では作成を省略する。
+ */
+FilePath synthetic_tree(std::size_t entries)
+{
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const FilePath base = benchmark_directory();
+    const FilePath root = base / FilePath("tree-" + std::to_string(entries));
+    const FilePath marker = base / FilePath("tree-" + std::to_string(entries) + ".complete");
+    if (marker.exists())
+        return root;
+
+    FilePath::remove_all(root);
+    FilePath::create_directories(root);
+    for (std::size_t i = 0; i < entries; ++i)
+    {
+        const FilePath directory = root / FilePath("d" + std::to_string(i / ENTRIES_PER_DIRECTORY));
+        if (i % ENTRIES_PER_DIRECTORY == 0)
+            FilePath::create_directory(directory);
+        std::ofstream((directory / FilePath("f" + std::to_string(i))).c_str());
+    }
+    std::ofstream(marker.c_str());
+    return root;
+}
+
+/**
+ * @brief synthetic_tree(entries) 直下のディレクトリ一覧
+ */
+std::vector<FilePath> tree_directories(std::size_t entries)
+{
+    std::vector<FilePath> result;
+    const FilePath root = synthetic_tree(entries);
+    for (std::size_t i = 0; i * ENTRIES_PER_DIRECTORY < entries; ++i)
+        result.push_back(root / FilePath("d" + std::to_string(i)));
+    return result;
+}
+
+/**
+ * @brief synthetic_tree(entries) の全ファイルのパス (1M の木でも stat のケースは先頭の 10k 件のみを用いる)
+ */
+const std::vector<FilePath>& tree_files(std::size_t entries)
+{
+    static std::map<std::size_t, std::vector<FilePath> > files;
+    std::vector<FilePath>& result = files[entries];
+    if (result.empty())
+    {
+        const FilePath root = synthetic_tree(entries);
+        const std::size_t count = std::min<std::size_t>(entries, 10000);
+        for (std::size_t i = 0; i < count; ++i)
+            result.push_back(root / FilePath("d" + std::to_string(i / ENTRIES_PER_DIRECTORY)) / FilePath("f" + std::to_string(i)));
+    }
+    return result;
+}
+
+/*
+ * 解析・連結・文字列化 (ファイルシステムへのアクセスなし)
+ */
+
+void BM_Parse(benchmark::State& state)
+{
+    const std::vector<std::string>& paths = manifest();
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            FilePath path(paths[i]);
+            benchmark::DoNotOptimize(path.c_str());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(BM_Parse);
+
+/**
+ * @brief 既存の FilePath への代入 (set() がバッファを再利用する)
+ */
+void BM_Assign(benchmark::State& state)
+{
+    const std::vector<std::string>& paths = manifest();
+    FilePath path;
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            path = paths[i];
+            benchmark::DoNotOptimize(path.c_str());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(BM_Assign);
+
+/**
+ * @brief コンポーネントへの分解 (以前の split() 相当)
+ */
+void BM_Components(benchmark::State& state)
+{
+    const std::vector<FilePath>& paths = manifest_paths();
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            std::size_t count = 0;
+            for (const FilePathView& component : paths[i].view())
+                count += component.size();
+            benchmark::DoNotOptimize(count);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(BM_Components);
+
+void BM_JoinChain(benchmark::State& state)
+{
+    const FilePath root("/mnt/nvme0/warehouse");
+    const FilePath tenant("tenant-42"), year("2026"), month("10"), file("part-00017.parquet");
+    for (auto _ : state)
+    {
+        FilePath path = root / tenant / year / month / file;
+        benchmark::DoNotOptimize(path.c_str());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_JoinChain);
+
+void BM_JoinAppend(benchmark::State& state)
+{
+    const FilePath root("/mnt/nvme0/warehouse");
+    const FilePath tenant("tenant-42"), year("2026"), month("10"), file("part-00017.parquet");
+    for (auto _ : state)
+    {
+        FilePath path(root);
+        path /= tenant;
+        path /= year;
+        path /= month;
+        path /= file;
+        benchmark::DoNotOptimize(path.c_str());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_JoinAppend);
+
+void BM_ToStr(benchmark::State& state)
+{
+    const std::vector<FilePath>& paths = manifest_paths();
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            std::string str = paths[i].to_str();
+            benchmark::DoNotOptimize(str.data());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(BM_ToStr);
+
+/**
+ * @brief 区切り文字の変換を伴う to_str()
+ */
+void BM_ToStrConvert(benchmark::State& state)
+{
+    const std::vector<FilePath>& paths = manifest_paths();
+    const FilePath::Platform other = (FilePath::NATIVE == FilePath::UNIX) ? FilePath::WINDOWS : FilePath::UNIX;
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            std::string str = paths[i].to_str(other);
+            benchmark::DoNotOptimize(str.data());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(BM_ToStrConvert);
+
+void BM_ParentPath(benchmark::State& state)
+{
+    const std::vector<FilePath>& paths = manifest_paths();
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            FilePath parent = paths[i].parent_path();
+            benchmark::DoNotOptimize(parent.c_str());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(BM_ParentPath);
+
+/*
+ * ディレクトリ走査 (引数は木全体のエントリ数)
+ */
+
+void BM_DirectoryIterator(benchmark::State& state)
+{
+    const std::vector<FilePath> directories = tree_directories(static_cast<std::size_t>(state.range(0)));
+    std::size_t count = 0;
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < directories.size(); ++i)
+        {
+            for (DirectoryIterator it(directories[i]), last; it != last; ++it)
+            {
+                benchmark::DoNotOptimize(it->path().c_str());
+                ++count;
+            }
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(count));
+}
+BENCHMARK(BM_DirectoryIterator)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief 全エントリを std::vector<FilePath> に読み込む FilePath::directory_iterator()
+ */
+void BM_DirectoryList(benchmark::State& state)
+{
+    const std::vector<FilePath> directories = tree_directories(static_cast<std::size_t>(state.range(0)));
+    std::size_t count = 0;
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < directories.size(); ++i)
+        {
+            std::vector<FilePath> entries = FilePath::directory_iterator(directories[i]);
+            benchmark::DoNotOptimize(entries.data());
+            count += entries.size();
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(count));
+}
+BENCHMARK(BM_DirectoryList)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+void BM_RecursiveDirectoryIterator(benchmark::State& state)
+{
+    const FilePath root = synthetic_tree(static_cast<std::size_t>(state.range(0)));
+    std::size_t count = 0;
+    for (auto _ : state)
+    {
+        for (RecursiveDirectoryIterator it(root), last; it != last; ++it)
+        {
+            benchmark::DoNotOptimize(it->path().c_str());
+            ++count;
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(count));
+}
+BENCHMARK(BM_RecursiveDirectoryIterator)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief FilePath::walk による並列走査 (ワーカー数はコア数)
+ */
+void BM_Walk(benchmark::State& state)
+{
+    const FilePath root = synthetic_tree(static_cast<std::size_t>(state.range(0)));
+    std::atomic<std::size_t> count(0);
+    for (auto _ : state)
+    {
+        FilePath::walk(root, [&count](const DirectoryEntry&, int) -> bool
+        {
+            ++count;
+            return true;
+        });
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(count.load()));
+}
+BENCHMARK(BM_Walk)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/*
+ * stat (10k 件のファイル)
+ */
+
+void BM_Exists(benchmark::State& state)
+{
+    const std::vector<FilePath>& files = tree_files(10000);
+    for (auto _ : state)
+    {
+        std::size_t found = 0;
+        for (std::size_t i = 0; i < files.size(); ++i)
+            found += files[i].exists() ? 1 : 0;
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * files.size()));
+}
+BENCHMARK(BM_Exists)->Unit(benchmark::kMillisecond);
+
+void BM_FileSize(benchmark::State& state)
+{
+    const std::vector<FilePath>& files = tree_files(10000);
+    for (auto _ : state)
+    {
+        int64_t total = 0;
+        for (std::size_t i = 0; i < files.size(); ++i)
+            total += files[i].file_size();
+        benchmark::DoNotOptimize(total);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * files.size()));
+}
+BENCHMARK(BM_FileSize)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief FilePath::status_batch (Linux では io_uring の statx で一括取得する)
+ */
+void BM_StatusBatch(benchmark::State& state)
+{
+    const std::vector<FilePath>& files = tree_files(10000);
+    for (auto _ : state)
+    {
+        std::vector<FileStatus> statuses = FilePath::status_batch(files);
+        benchmark::DoNotOptimize(statuses.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * files.size()));
+}
+BENCHMARK(BM_StatusBatch)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief 有効期間内の StatCache を介した exists() (2回目以降はシステムコールなし)
+ */
+void BM_ExistsCached(benchmark::State& state)
+{
+    const std::vector<FilePath>& files = tree_files(10000);
+    StatCacheOptions options;
+    options.ttl_ms = 60000;
+    StatCache cache(options);
+    for (auto _ : state)
+    {
+        std::size_t found = 0;
+        for (std::size_t i = 0; i < files.size(); ++i)
+            found += files[i].exists(cache) ? 1 : 0;
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * files.size()));
+}
+BENCHMARK(BM_ExistsCached)->Unit(benchmark::kMillisecond);
+
+#ifdef FILE_PATH_BENCHMARK_HAS_STD_FILESYSTEM
+/*
+ * std::filesystem による同じ操作 (比較用)
+ */
+
+namespace fs = std::filesystem;
+
+const std::vector<fs::path>& std_manifest_paths()
+{
+    static const std::vector<fs::path> paths(manifest().begin(), manifest().end());
+    return paths;
+}
+
+void BM_StdParse(benchmark::State& state)
+{
+    const std::vector<std::string>& paths = manifest();
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            fs::path path(paths[i]);
+            benchmark::DoNotOptimize(path.c_str());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(BM_StdParse);
+
+void BM_StdAssign(benchmark::State& state)
+{
+    const std::vector<std::string>& paths = manifest();
+    fs::path path;
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            path = paths[i];
+            benchmark::DoNotOptimize(path.c_str());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(BM_StdAssign);
+
+void BM_StdComponents(benchmark::State& state)
+{
+    const std::vector<fs::path>& paths = std_manifest_paths();
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            std::size_t count = 0;
+            for (const fs::path& component : paths[i])
+                count += component.native().size();
+            benchmark::DoNotOptimize(count);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(BM_StdComponents);
+
+void BM_StdJoinChain(benchmark::State& state)
+{
+    const fs::path root("/mnt/nvme0/warehouse");
+    const fs::path tenant("tenant-42"), year("2026"), month("10"), file("part-00017.parquet");
+    for (auto _ : state)
+    {
+        fs::path path = root / tenant / year / month / file;
+        benchmark::DoNotOptimize(path.c_str());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_StdJoinChain);
+
+void BM_StdJoinAppend(benchmark::State& state)
+{
+    const fs::path root("/mnt/nvme0/warehouse");
+    const fs::path tenant("tenant-42"), year("2026"), month("10"), file("part-00017.parquet");
+    for (auto _ : state)
+    {
+        fs::path path(root);
+        path /= tenant;
+        path /= year;
+        path /= month;
+        path /= file;
+        benchmark::DoNotOptimize(path.c_str());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_StdJoinAppend);
+
+void BM_StdToStr(benchmark::State& state)
+{
+    const std::vector<fs::path>& paths = std_manifest_paths();
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            std::string str = paths[i].string();
+            benchmark::DoNotOptimize(str.data());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(BM_StdToStr);
+
+void BM_StdParentPath(benchmark::State& state)
+{
+    const std::vector<fs::path>& paths = std_manifest_paths();
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            fs::path parent = paths[i].parent_path();
+            benchmark::DoNotOptimize(parent.c_str());
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(BM_StdParentPath);
+
+void BM_StdDirectoryIterator(benchmark::State& state)
+{
+    const std::vector<FilePath> directories = tree_directories(static_cast<std::size_t>(state.range(0)));
+    std::size_t count = 0;
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < directories.size(); ++i)
+        {
+            for (const fs::directory_entry& entry : fs::directory_iterator(directories[i].to_str()))
+            {
+                benchmark::DoNotOptimize(entry.path().c_str());
+                ++count;
+            }
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(count));
+}
+BENCHMARK(BM_StdDirectoryIterator)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+void BM_StdRecursiveDirectoryIterator(benchmark::State& state)
+{
+    const FilePath root = synthetic_tree(static_cast<std::size_t>(state.range(0)));
+    std::size_t count = 0;
+    for (auto _ : state)
+    {
+        for (const fs::directory_entry& entry : fs::recursive_directory_iterator(root.to_str()))
+        {
+            benchmark::DoNotOptimize(entry.path().c_str());
+            ++count;
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(count));
+}
+BENCHMARK(BM_StdRecursiveDirectoryIterator)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+const std::vector<fs::path>& std_tree_files()
+{
+    static std::vector<fs::path> files;
+    if (files.empty())
+    {
+        const std::vector<FilePath>& source = tree_files(10000);
+        for (std::size_t i = 0; i < source.size(); ++i)
+            files.push_back(fs::path(source[i].to_str()));
+    }
+    return files;
+}
+
+void BM_StdExists(benchmark::State& state)
+{
+    const std::vector<fs::path>& files = std_tree_files();
+    for (auto _ : state)
+    {
+        std::size_t found = 0;
+        for (std::size_t i = 0; i < files.size(); ++i)
+            found += fs::exists(files[i]) ? 1 : 0;
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * files.size()));
+}
+BENCHMARK(BM_StdExists)->Unit(benchmark::kMillisecond);
+
+void BM_StdFileSize(benchmark::State& state)
+{
+    const std::vector<fs::path>& files = std_tree_files();
+    for (auto _ : state)
+    {
+        uintmax_t total = 0;
+        std::error_code ec;
+        for (std::size_t i = 0; i < files.size(); ++i)
+            total += fs::file_size(files[i], ec);
+        benchmark::DoNotOptimize(total);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * files.size()));
+}
+BENCHMARK(BM_StdFileSize)->Unit(benchmark::kMillisecond);
+#endif
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,140 @@
+/**
+ * @file split_benchmark.cpp
+ * @brief FilePath の区切り文字走査 (set()) と、以前の find_first_of + substr による split() の比較
+ * 
+ * ビルド例:
+ *   g++ -std=c++11 -O2 -I.. split_benchmark.cpp -lbenchmark -lpthread -o split_benchmark
+ *   g++ -std=c++11 -O2 -mavx2 -I.. split_benchmark.cpp -lbenchmark -lpthread -o split_benchmark_avx2
+ */
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "file_path.hpp"
+
+namespace
+{
+
+/**
+ * @brief 以前の FilePath::split() (コンポーネントごとに std::string を生成する)
+ */
+std::vector<std::string> legacy_split(const std::string& origin, const std::string &delim)
+{
+    std::vector<std::string> result;
+    std::size_t last_pos = 0;
+    std::size_t find_pos = origin.find_first_of(delim, last_pos);
+
+    while (last_pos != std::string::npos)
+    {
+        if (find_pos != last_pos)
+            result.push_back(origin.substr(last_pos, find_pos - last_pos));
+        last_pos = find_pos;
+        if (last_pos == std::string::npos || last_pos == origin.size()-1)
+            break;
+        last_pos++;
+        find_pos = origin.find_first_of(delim, last_pos);
+    }
+
+    return result;
+}
+
+std::vector<std::string> make_manifest(std::size_t count)
+{
+    static const char* const roots[] = { "/data/tenant", "/var/spool/ingest", "/mnt/nvme0/warehouse/events" };
+    std::vector<std::string> result;
+    result.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::string path = roots[i % 3];
+        path += "/2026/10/" + std::to_string(i % 31) + "/shard-" + std::to_string(i % 977);
+        path += "/part-" + std::to_string(i) + ".parquet";
+        result.push_back(path);
+    }
+    return result;
+}
+
+const std::vector<std::string>& manifest()
+{
+    static const std::vector<std::string> paths = make_manifest(4096);
+    return paths;
+}
+
+void BM_LegacySplit(benchmark::State& state)
+{
+    const std::vector<std::string>& paths = manifest();
+    std::size_t bytes = 0;
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            std::vector<std::string> parts = legacy_split(paths[i], "/\\");
+            benchmark::DoNotOptimize(parts.data());
+            bytes += paths[i].size();
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(BM_LegacySplit);
+
+void BM_FilePathParse(benchmark::State& state)
+{
+    const std::vector<std::string>& paths = manifest();
+    std::size_t bytes = 0;
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            FilePath path(paths[i]);
+            benchmark::DoNotOptimize(path.c_str());
+            bytes += paths[i].size();
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(BM_FilePathParse);
+
+void BM_FilePathParseWindows(benchmark::State& state)
+{
+    const std::vector<std::string>& paths = manifest();
+    std::size_t bytes = 0;
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            FilePath path(FilePathView(paths[i], FilePath::WINDOWS));
+            benchmark::DoNotOptimize(path.c_str());
+            bytes += paths[i].size();
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(BM_FilePathParseWindows);
+
+void BM_FilePathViewComponents(benchmark::State& state)
+{
+    const std::vector<std::string>& paths = manifest();
+    std::size_t bytes = 0;
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            std::size_t count = 0;
+            for (const FilePathView& component : FilePathView(paths[i]))
+                count += component.size();
+            benchmark::DoNotOptimize(count);
+            bytes += paths[i].size();
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+}
+BENCHMARK(BM_FilePathViewComponents);
+
+}
+
+BENCHMARK_MAIN();
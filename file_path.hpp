@@ -13,24 +13,583 @@
 #define _UTILITY_FILE_PATH_HPP_
 
 #include <vector>
+#include <algorithm>
+#include <utility>
+#include <deque>
+#include <set>
+#include <map>
+#include <unordered_map>
 #include <string>
+#include <memory>
+#include <iterator>
+#include <type_traits>
+#include <functional>
+#include <exception>
+#include <cstddef>
 #include <sstream>
 #include <fstream>
 #include <cctype>
 #include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <future>
+#include <chrono>
 
 #include <sys/stat.h>
 
 #ifdef __unix__
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/time.h>
 #include <dirent.h>
+#include <sys/mman.h>
 #include <linux/limits.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+#endif
 #else
 #include <windows.h>
 #include <fileapi.h>
 #endif
 
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__linux__) && !defined(FILE_PATH_DISABLE_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#if defined(IORING_FEAT_CUR_PERSONALITY) && defined(STATX_BASIC_STATS) && defined(__NR_io_uring_setup)
+#define FILE_PATH_HAS_IO_URING 1
+#endif
+#endif
+#endif
+
+#ifdef FILE_PATH_ENABLE_INSTRUMENTATION
+/**
+ * @class FilePathStats
+ * @brief FILE_PATH_ENABLE_INSTRUMENTATION を定義した場合のみ有効となる、システムコールなどの回数と所要時間の計測
+ * 
+ * 各呼び出し箇所は FILE_PATH_TRACE などのマクロで計測し、定義しない場合はマクロが空に展開されるためコストは発生しない。
+ * カウンタはスレッドごとに割り当てたスロット (キャッシュライン境界に揃えた std::atomic の配列) への relaxed な加算のみで更新し、
+ * snapshot() が全スロットを合算する。所要時間は [2^i, 2^(i+1)) ns の区間ごとのヒストグラムとして記録する。
+ * 
+ * @code
+ * const FilePathStats::Snapshot before = FilePathStats::snapshot();
+ * run_workload();
+ * std::cout << (FilePathStats::snapshot() - before) << std::endl;     // 回数が 0 でない操作の回数 / 平均 / p50 / p99
+ * @endcode
+ */
+class FilePathStats
+{
+public:
+    enum Operation
+    {
+        STAT,               /**< stat / lstat / fstat / fstatat (Windows では GetFileAttributesEx) */
+        STATX_BATCH,        /**< io_uring_enter による statx の一括投入 (投入1回を1回と数える) */
+        OPEN_DIRECTORY,     /**< opendir / openat(O_DIRECTORY) (Windows では FindFirstFile) */
+        READ_DIRECTORY,     /**< readdir (Windows では FindNextFile) の呼び出し (回数のみ) */
+        REALPATH,           /**< realpath (Windows では GetFullPathName) */
+        OPEN_FILE,          /**< MappedFile / DirectoryHandle::open によるファイルのオープン */
+        CREATE_DIRECTORY,
+        REMOVE,             /**< ファイルまたはディレクトリの削除 */
+        RENAME,
+        COPY_FILE,          /**< copy_file() 全体 (内部の open / fstat を含む) */
+        TO_STR,             /**< to_str() による文字列の生成 (回数のみ) */
+        ALLOCATION,         /**< パスのバッファのヒープ確保 (容量の拡張と SSO に収まらないコピー, 回数のみ) */
+        OPERATION_COUNT
+    };
+
+    static const std::size_t BUCKETS = 32;      /**< ヒストグラムの区間数 (最後の区間は 2^31 ns 以上を含む) */
+
+    /**
+     * @struct FilePathStats::Counter
+     * @brief 1つの操作の集計値
+     */
+    struct Counter
+    {
+        uint64_t count;
+        uint64_t total_ns;                      /**< 所要時間の合計 (回数のみの操作では 0) */
+        uint64_t histogram[BUCKETS];            /**< histogram[i] は所要時間が [2^i, 2^(i+1)) ns であった回数 */
+
+        double mean_ns() const
+        {
+            return (count == 0) ? 0.0 : static_cast<double>(total_ns) / static_cast<double>(count);
+        }
+
+        /**
+         * @brief 所要時間の分位点の上界 [ns] (記録がない場合は 0)
+         * 
+         * @param p 0.0 - 1.0 (0.99 で p99)
+         */
+        uint64_t percentile(double p) const
+        {
+            uint64_t total = 0;
+            for (std::size_t i = 0; i < BUCKETS; ++i)
+                total += histogram[i];
+            if (total == 0)
+                return 0;
+            // 最近傍順位法 (ceil(p * total) 番目の記録が含まれる区間)
+            const double target = p * static_cast<double>(total);
+            uint64_t rank = static_cast<uint64_t>(target);
+            if (static_cast<double>(rank) < target)
+                ++rank;
+            if (rank > 0)
+                --rank;
+            uint64_t cumulative = 0;
+            for (std::size_t i = 0; i < BUCKETS; ++i)
+            {
+                cumulative += histogram[i];
+                if (cumulative > rank)
+                    return static_cast<uint64_t>(1) << (i + 1);
+            }
+            return static_cast<uint64_t>(1) << BUCKETS;
+        }
+    };
+
+    /**
+     * @struct FilePathStats::Snapshot
+     * @brief snapshot() 時点の全操作の集計値
+     */
+    struct Snapshot
+    {
+        Counter counters[OPERATION_COUNT];
+
+        const Counter& operator[](Operation operation) const
+        {
+            return counters[operation];
+        }
+
+        /**
+         * @brief 2つの時点の差分 (計測区間の集計に用いる)
+         */
+        friend Snapshot operator-(const Snapshot& lhs, const Snapshot& rhs)
+        {
+            Snapshot result = lhs;
+            for (std::size_t op = 0; op < OPERATION_COUNT; ++op)
+            {
+                result.counters[op].count    -= rhs.counters[op].count;
+                result.counters[op].total_ns -= rhs.counters[op].total_ns;
+                for (std::size_t i = 0; i < BUCKETS; ++i)
+                    result.counters[op].histogram[i] -= rhs.counters[op].histogram[i];
+            }
+            return result;
+        }
+
+        friend std::ostream& operator<<(std::ostream& os, const Snapshot& snapshot)
+        {
+            for (std::size_t op = 0; op < OPERATION_COUNT; ++op)
+            {
+                const Counter& counter = snapshot.counters[op];
+                if (counter.count == 0)
+                    continue;
+                os << name(static_cast<Operation>(op)) << ": count=" << counter.count;
+                if (counter.total_ns > 0)
+                    os << " mean=" << static_cast<uint64_t>(counter.mean_ns()) << "ns p50<=" << counter.percentile(0.5) << "ns p99<=" << counter.percentile(0.99) << "ns";
+                os << '\n';
+            }
+            return os;
+        }
+    };
+
+    static const char* name(Operation operation)
+    {
+        static const char* const names[OPERATION_COUNT] =
+        {
+            "stat", "statx_batch", "open_directory", "read_directory", "realpath", "open_file",
+            "create_directory", "remove", "rename", "copy_file", "to_str", "allocation"
+        };
+        return (operation < OPERATION_COUNT) ? names[operation] : "unknown";
+    }
+
+    /**
+     * @brief 所要時間を伴わずに回数のみを記録する
+     */
+    static void count(Operation operation)
+    {
+        local().count[operation].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void record(Operation operation, uint64_t ns)
+    {
+        Slot& slot = local();
+        slot.count[operation].fetch_add(1, std::memory_order_relaxed);
+        slot.total_ns[operation].fetch_add(ns, std::memory_order_relaxed);
+        slot.histogram[operation][bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief コピー直後の string の容量が SSO に収まらなければ、ヒープ確保として数える
+     */
+    static void count_copy(const std::string& string)
+    {
+        if (string.capacity() > inline_capacity())
+            count(ALLOCATION);
+    }
+
+    /**
+     * @brief 全スレッドの集計値を合算する (他のスレッドが記録中の値は含まれない場合がある)
+     */
+    static Snapshot snapshot()
+    {
+        Snapshot result = Snapshot();
+        const Slot* slot = slots();
+        for (std::size_t s = 0; s < SLOTS; ++s)
+        {
+            for (std::size_t op = 0; op < OPERATION_COUNT; ++op)
+            {
+                Counter& counter = result.counters[op];
+                counter.count    += slot[s].count[op].load(std::memory_order_relaxed);
+                counter.total_ns += slot[s].total_ns[op].load(std::memory_order_relaxed);
+                for (std::size_t i = 0; i < BUCKETS; ++i)
+                    counter.histogram[i] += slot[s].histogram[op][i].load(std::memory_order_relaxed);
+            }
+        }
+        return result;
+    }
+
+    static void reset()
+    {
+        Slot* slot = slots();
+        for (std::size_t s = 0; s < SLOTS; ++s)
+        {
+            for (std::size_t op = 0; op < OPERATION_COUNT; ++op)
+            {
+                slot[s].count[op].store(0, std::memory_order_relaxed);
+                slot[s].total_ns[op].store(0, std::memory_order_relaxed);
+                for (std::size_t i = 0; i < BUCKETS; ++i)
+                    slot[s].histogram[op][i].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @class FilePathStats::Scope
+     * @brief 生成から破棄までの所要時間を operation として記録する (FILE_PATH_TRACE が生成する)
+     */
+    class Scope
+    {
+    public:
+        explicit Scope(Operation operation)
+         :  operation_(operation), start_(std::chrono::steady_clock::now())
+        {}
+
+        ~Scope()
+        {
+            const std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start_;
+            record(operation_, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        }
+
+    private:
+        const Operation operation_;
+        const std::chrono::steady_clock::time_point start_;
+
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+    };
+
+    /**
+     * @class FilePathStats::GrowthScope
+     * @brief 破棄時に string の容量が拡張されていれば、ヒープ確保として数える (FILE_PATH_TRACE_GROWTH が生成する)
+     */
+    class GrowthScope
+    {
+    public:
+        explicit GrowthScope(const std::string& string)
+         :  string_(string), capacity_(string.capacity())
+        {}
+
+        ~GrowthScope()
+        {
+            if (string_.capacity() != capacity_ && string_.capacity() > inline_capacity())
+                count(ALLOCATION);
+        }
+
+    private:
+        const std::string& string_;
+        const std::size_t capacity_;
+
+        GrowthScope(const GrowthScope&);
+        GrowthScope& operator=(const GrowthScope&);
+    };
+
+private:
+    static const std::size_t SLOTS = 16;        /**< スレッドは生成順にスロットへ割り当てる */
+
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> count[OPERATION_COUNT];
+        std::atomic<uint64_t> total_ns[OPERATION_COUNT];
+        std::atomic<uint64_t> histogram[OPERATION_COUNT][BUCKETS];
+    };
+
+    static Slot* slots()
+    {
+        static Slot instance[SLOTS];            // 静的記憶域のため 0 で初期化される
+        return instance;
+    }
+
+    static Slot& local()
+    {
+        static std::atomic<unsigned> next(0);
+        static thread_local Slot* const slot = &slots()[next.fetch_add(1, std::memory_order_relaxed) % SLOTS];
+        return *slot;
+    }
+
+    static std::size_t bucket(uint64_t ns)
+    {
+        std::size_t i = 0;
+        while (ns > 1 && i + 1 < BUCKETS)
+        {
+            ns >>= 1;
+            ++i;
+        }
+        return i;
+    }
+
+    static std::size_t inline_capacity()
+    {
+        static const std::size_t capacity = std::string().capacity();
+        return capacity;
+    }
+};
+
+#define FILE_PATH_TRACE(operation)          FilePathStats::Scope file_path_trace_scope_(FilePathStats::operation)
+#define FILE_PATH_COUNT(operation)          FilePathStats::count(FilePathStats::operation)
+#define FILE_PATH_TRACE_GROWTH(string)      FilePathStats::GrowthScope file_path_growth_scope_(string)
+#define FILE_PATH_COUNT_COPY(string)        FilePathStats::count_copy(string)
+#else
+#define FILE_PATH_TRACE(operation)          ((void)0)
+#define FILE_PATH_COUNT(operation)          ((void)0)
+#define FILE_PATH_TRACE_GROWTH(string)      ((void)0)
+#define FILE_PATH_COUNT_COPY(string)        ((void)0)
+#endif
+
+/**
+ * @class FileStatus
+ * @brief 1回の stat / lstat (Windows では GetFileAttributesEx) で取得したファイル属性を保持する値型
+ * 
+ * 取得済みの FileStatus を FilePath::is_file(const FileStatus&) などへ渡すことで、
+ * 同じファイルに対する判定を追加のシステムコールなしで繰り返すことができる。
+ */
+class FileStatus
+{
+public:
+    enum Type
+    {
+        NONE        = 0,    /**< 属性の取得に失敗した */
+        NOT_FOUND   = 1,    /**< ファイルが存在しない */
+        REGULAR     = 2,
+        DIRECTORY   = 3,
+        SYMLINK     = 4,
+        BLOCK       = 5,
+        CHARACTER   = 6,
+        FIFO        = 7,
+        SOCKET      = 8,
+        UNKNOWN     = 9
+    };
+
+    FileStatus()
+     :  type_(NONE), size_(-1), allocated_(-1), mtime_(0), permissions_(0), inode_(0), device_(0), links_(0)
+    {}
+
+    explicit FileStatus(Type type, uint64_t inode = 0)
+     :  type_(type), size_(-1), allocated_(-1), mtime_(0), permissions_(0), inode_(inode), device_(0), links_(0)
+    {}
+
+#ifdef __unix__
+    explicit FileStatus(const struct stat& st)
+     :  type_(to_type(st.st_mode)), size_(st.st_size), allocated_(static_cast<int64_t>(st.st_blocks) * 512),
+        mtime_(static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec),
+        permissions_(static_cast<uint32_t>(st.st_mode & 07777)),
+        inode_(static_cast<uint64_t>(st.st_ino)), device_(static_cast<uint64_t>(st.st_dev)),
+        links_(static_cast<uint64_t>(st.st_nlink))
+    {}
+
+#ifdef FILE_PATH_HAS_IO_URING
+    explicit FileStatus(const struct statx& st)
+     :  type_(to_type(st.stx_mode)), size_(static_cast<int64_t>(st.stx_size)), allocated_(static_cast<int64_t>(st.stx_blocks) * 512),
+        mtime_(static_cast<int64_t>(st.stx_mtime.tv_sec) * 1000000000 + st.stx_mtime.tv_nsec),
+        permissions_(static_cast<uint32_t>(st.stx_mode & 07777)),
+        inode_(static_cast<uint64_t>(st.stx_ino)), device_(static_cast<uint64_t>(makedev(st.stx_dev_major, st.stx_dev_minor))),
+        links_(static_cast<uint64_t>(st.stx_nlink))
+    {}
+#endif
+#else
+    FileStatus(DWORD attributes, const FILETIME& last_write_time, DWORD size_high, DWORD size_low, bool follow_symlink)
+     :  type_(to_type(attributes, follow_symlink)),
+        size_((static_cast<int64_t>(size_high) << 32) | size_low), allocated_(-1),
+        mtime_(to_unix_time(last_write_time)),
+        permissions_(to_permissions(attributes)), inode_(0), device_(0), links_(0)
+    {}
+#endif
+
+    Type type() const               { return type_; }
+    bool exists() const             { return type_ != NONE && type_ != NOT_FOUND; }
+    bool is_file() const            { return type_ == REGULAR; }
+    bool is_directory() const       { return type_ == DIRECTORY; }
+    bool is_symlink() const         { return type_ == SYMLINK; }
+
+    /** @brief ファイルサイズ [byte] (取得できない場合は -1) */
+    int64_t size() const            { return size_; }
+
+    /** @brief 割り当て済みのディスク容量 [byte] (st_blocks * 512 、取得できない場合や Windows では -1) */
+    int64_t allocated() const       { return allocated_; }
+
+    /** @brief 最終更新時刻 [ns] (UNIX エポックからの経過時間) */
+    int64_t mtime() const           { return mtime_; }
+
+    /** @brief パーミッション (POSIX の st_mode 下位 12bit 相当) */
+    uint32_t permissions() const    { return permissions_; }
+
+    /** @brief inode 番号 (Windows では 0) */
+    uint64_t inode() const          { return inode_; }
+
+    /** @brief デバイス番号 (Windows では 0) */
+    uint64_t device() const         { return device_; }
+
+    /** @brief ハードリンク数 (取得できない場合や Windows では 0) */
+    uint64_t link_count() const     { return links_; }
+
+#ifdef __unix__
+    /**
+     * @brief stat 系の呼び出しが失敗した際の errno から FileStatus を生成する
+     */
+    static FileStatus from_errno(int error)
+    {
+        return FileStatus((error == ENOENT || error == ENOTDIR) ? NOT_FOUND : NONE);
+    }
+#endif
+
+private:
+    Type type_;
+    int64_t size_;
+    int64_t allocated_;
+    int64_t mtime_;
+    uint32_t permissions_;
+    uint64_t inode_;
+    uint64_t device_;
+    uint64_t links_;
+
+#ifdef __unix__
+    static Type to_type(mode_t mode)
+    {
+        if (S_ISREG(mode))  return REGULAR;
+        if (S_ISDIR(mode))  return DIRECTORY;
+        if (S_ISLNK(mode))  return SYMLINK;
+        if (S_ISBLK(mode))  return BLOCK;
+        if (S_ISCHR(mode))  return CHARACTER;
+        if (S_ISFIFO(mode)) return FIFO;
+        if (S_ISSOCK(mode)) return SOCKET;
+        return UNKNOWN;
+    }
+#else
+    static Type to_type(DWORD attributes, bool follow_symlink)
+    {
+        if (!follow_symlink && (attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
+            return SYMLINK;
+        if ((attributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+            return DIRECTORY;
+        return REGULAR;
+    }
+
+    static int64_t to_unix_time(const FILETIME& time)
+    {
+        const int64_t ticks = (static_cast<int64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+        return (ticks - 116444736000000000LL) * 100;
+    }
+
+    static uint32_t to_permissions(DWORD attributes)
+    {
+        uint32_t permissions = ((attributes & FILE_ATTRIBUTE_READONLY) != 0) ? 0444 : 0666;
+        if ((attributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+            permissions |= 0111;
+        return permissions;
+    }
+#endif
+};
+
+/**
+ * @struct WalkOptions
+ * @brief RecursiveDirectoryIterator / FilePath::walk の走査オプション
+ */
+struct WalkOptions
+{
+    unsigned threads;                   /**< FilePath::walk のワーカースレッド数 (0 の場合はコア数) */
+    int max_depth;                      /**< 降りる深さの上限 (0 で直下のみ, 負の値で無制限) */
+    bool follow_symlinks;               /**< ディレクトリへのシンボリックリンクを辿るか否か */
+
+    WalkOptions()
+     :  threads(0), max_depth(-1), follow_symlinks(false)
+    {}
+};
+
+/**
+ * @struct DiskUsageOptions
+ * @brief FilePath::disk_usage の集計オプション
+ */
+struct DiskUsageOptions
+{
+    unsigned threads;                   /**< ワーカースレッド数 (0 の場合はコア数) */
+    int max_depth;                      /**< 結果の木に残すディレクトリの深さ (0 で root のみ, 負の値で無制限) 。集計は常に全体に対して行う */
+    bool dedupe_hard_links;             /**< 同じ (device, inode) を持つハードリンクの容量を一度だけ数えるか否か */
+    bool one_file_system;               /**< root と異なるファイルシステム上のディレクトリを除外するか否か */
+
+    DiskUsageOptions()
+     :  threads(0), max_depth(-1), dedupe_hard_links(true), one_file_system(false)
+    {}
+};
+
+/**
+ * @struct FileOperationResult
+ * @brief FilePath::create_directories / remove_all の結果
+ */
+struct FileOperationResult
+{
+    std::size_t count;                  /**< 作成 / 削除したエントリ数 */
+    std::size_t failures;               /**< 失敗したエントリ数 */
+    int error;                          /**< 最初に失敗したときのエラー番号 (POSIX では errno 、Windows では GetLastError) */
+    std::string error_path;             /**< 最初に失敗したエントリのパス */
+
+    FileOperationResult()
+     :  count(0), failures(0), error(0), error_path()
+    {}
+
+    bool ok() const
+    {
+        return failures == 0;
+    }
+};
+
+class DirectoryEntry;
+struct DiskUsage;
+class FilePathView;
+class MonotonicArena;
+template<class T> class ArenaAllocator;
+class MappedFile;
+class StatCache;
+
 /**
  * @class FilePath
  * @brief c++11/c++14 環境におけるstd::filesystem 名前空間の代替クラス 
@@ -51,442 +610,7550 @@ public:
     };
 
     FilePath()
-     :  platform_(NATIVE), is_absolute_(false) 
+     :  path_(), hash_(HASH_BASIS), is_absolute_(false), platform_(NATIVE)
     {}
 
     FilePath(const FilePath &path)
-     :  platform_(path.platform_), path_(path.path_), is_absolute_(path.is_absolute_)
-    {}
+     :  path_(path.path_), hash_(path.hash_), is_absolute_(path.is_absolute_), platform_(path.platform_)
+#ifndef __unix__
+        , native_(path.native_)
+#endif
+    {
+        FILE_PATH_COUNT_COPY(path_);
+    }
+
+    FilePath(FilePath &&path) noexcept
+     :  path_(std::move(path.path_)), hash_(path.hash_), is_absolute_(path.is_absolute_), platform_(path.platform_)
+#ifndef __unix__
+        , native_(std::move(path.native_))
+#endif
+    {
+        path.path_.clear();
+        path.hash_ = HASH_BASIS;
+        path.is_absolute_ = false;
+#ifndef __unix__
+        path.native_.clear();
+#endif
+    }
 
     FilePath(const char* path_str)
+     :  path_(), hash_(HASH_BASIS), is_absolute_(false), platform_(NATIVE)
     { 
         set(path_str); 
     }
 
     FilePath(const std::string& path_str) 
+     :  path_(), hash_(HASH_BASIS), is_absolute_(false), platform_(NATIVE)
     { 
         set(path_str); 
     }
 
     FilePath(const std::wstring& path_str)
+     :  path_(), hash_(HASH_BASIS), is_absolute_(false), platform_(NATIVE)
     {
         set(path_str);
     }
 
-    void operator=(const FilePath &path)
+    /**
+     * @brief 借用しているパス文字列を解析し、所有する FilePath を生成する
+     */
+    explicit FilePath(const FilePathView& view);
+
+    FilePath& operator=(const FilePath &path)
     {
+        FILE_PATH_TRACE_GROWTH(path_);
         platform_       = path.platform_;
         path_           = path.path_;
+        hash_           = path.hash_;
         is_absolute_    = path.is_absolute_;
+#ifndef __unix__
+        native_         = path.native_;
+#endif
+        return *this;
+    }
+
+    FilePath& operator=(FilePath &&path) noexcept
+    {
+        platform_       = path.platform_;
+        path_           = std::move(path.path_);
+        hash_           = path.hash_;
+        is_absolute_    = path.is_absolute_;
+        path.path_.clear();
+        path.hash_      = HASH_BASIS;
+        path.is_absolute_ = false;
+#ifndef __unix__
+        native_         = std::move(path.native_);
+        path.native_.clear();
+#endif
+        return *this;
     }
 
-    void operator=(const char* path_str)
+    FilePath& operator=(const char* path_str)
     {
         set(path_str);
+        return *this;
     }
 
-    void operator=(const std::string& path_str)
+    FilePath& operator=(const std::string& path_str)
     {
         set(path_str);
+        return *this;
+    }
+
+    /**
+     * @brief 自身の末尾へ相対パスを連結する (バッファへの追記のみでコピーは発生しない)
+     * 
+     * @param other 連結する相対パス
+     * @return FilePath& 
+     */
+    FilePath& operator/=(const FilePath &other)
+    {
+        if (other.is_absolute_)
+            throw std::runtime_error("FilePath::operator/=(): expected a relative path!");
+        if (platform_ != other.platform_)
+            throw std::runtime_error("FilePath::operator/=(): expected a path of the same type!");
+
+        append_components(other);
+        return *this;
     }
 
-    FilePath operator/(const FilePath &other) const
+    FilePath operator/(const FilePath &other) const &
     {
         if (other.is_absolute_)
             throw std::runtime_error("FilePath::operator/(): expected a relative path!");
         if (platform_ != other.platform_)
             throw std::runtime_error("FilePath::operator/(): expected a path of the same type!");
 
-        FilePath result(*this);
+        FilePath result;
+        result.platform_    = platform_;
+        result.is_absolute_ = is_absolute_;
+        result.path_.reserve(path_.size() + 1 + other.path_.size());
+        result.path_        = path_;
+        result.hash_        = hash_;
+#ifndef __unix__
+        result.native_      = native_;     // append_components() は hash_ と同じく native_ へ差分だけ追記する
+#endif
+        result.append_components(other);
+        return result;
+    }
+
+    /**
+     * @brief 一時オブジェクトに対する連結。左辺のバッファへ追記してそのまま返すため、
+     *        root / a / b / c のような連結で左辺のコピーが発生しない
+     */
+    FilePath operator/(const FilePath &other) &&
+    {
+        *this /= other;
+        return std::move(*this);
+    }
+
+    /**
+     * @brief 正規化済みのパス文字列に対するハッシュ値 (変更のたびに差分だけ更新済みのため O(1))
+     * 
+     * @return std::size_t 
+     */
+    std::size_t hash() const
+    {
+        return static_cast<std::size_t>(hash_);
+    }
+
+    /**
+     * @brief 等価比較。ハッシュ値と長さで先に不一致を判定するため、異なるパス同士の比較は文字列を走査しない
+     */
+    bool operator==(const FilePath& other) const
+    {
+        return hash_ == other.hash_ && path_.size() == other.path_.size() && platform_ == other.platform_ && path_ == other.path_;
+    }
+
+    bool operator!=(const FilePath& other) const
+    {
+        return !(*this == other);
+    }
+
+    /**
+     * @brief コンポーネント単位の辞書順比較 ("a/b" < "a-b" となり、同じディレクトリの要素が連続して並ぶ)
+     */
+    bool operator<(const FilePath& other) const
+    {
+        if (platform_ != other.platform_)
+            return platform_ < other.platform_;
+
+        const std::size_t size = std::min(path_.size(), other.path_.size());
+        const char sep = separator();
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            const unsigned char lhs = static_cast<unsigned char>(path_[i]);
+            const unsigned char rhs = static_cast<unsigned char>(other.path_[i]);
+            if (lhs == rhs)
+                continue;
+            if (lhs == static_cast<unsigned char>(sep))
+                return true;
+            if (rhs == static_cast<unsigned char>(sep))
+                return false;
+            return lhs < rhs;
+        }
+        return path_.size() < other.path_.size();
+    }
+
+    bool operator>(const FilePath& other) const
+    {
+        return other < *this;
+    }
+
+    bool operator<=(const FilePath& other) const
+    {
+        return !(other < *this);
+    }
+
+    bool operator>=(const FilePath& other) const
+    {
+        return !(*this < other);
+    }
+
+    /**
+     * @brief to_str() と同じくネイティブ形式で出力する (プラットフォームが一致する場合は内部バッファをそのまま書き出す)
+     */
+    friend std::ostream& operator<<(std::ostream& os, const FilePath& path)
+    {
+        if (path.platform_ == NATIVE)
+            os << path.path_;
+        else
+            os << path.to_str();
+        return os;
+    }
+
+    /**
+     * @brief 
+     * 
+     * @return int64_t 
+     */
+    int64_t file_size() const 
+    {
+        return file_size(status());
+    }
+
+    /**
+     * @brief cache を介してファイルサイズを取得する (有効なエントリがあればシステムコールなし)
+     */
+    int64_t file_size(StatCache& cache) const
+    {
+        return file_size(status(cache));
+    }
+
+    /**
+     * @brief ファイルサイズを取得する (失敗した理由を ec へ格納する)
+     * 
+     * @param ec 失敗時はエラー、成功時はクリアされる
+     * @return int64_t 失敗時は -1
+     */
+    int64_t file_size(std::error_code& ec) const
+    {
+        const FileStatus st = status(ec);
+        if (ec)
+            return -1;
+        if (st.type() == FileStatus::NOT_FOUND)
+            ec = std::make_error_code(std::errc::no_such_file_or_directory);
+        else if (st.is_directory())
+            ec = std::make_error_code(std::errc::is_a_directory);
+        else if (!st.is_file())
+            ec = std::make_error_code(std::errc::not_supported);
+        return file_size(st);
+    }
+
+    /**
+     * @brief 取得済みの属性からファイルサイズを取得する (システムコールなし)
+     * 
+     * @param st status() の戻り値
+     * @return int64_t 通常ファイルでない場合は -1
+     */
+    static int64_t file_size(const FileStatus& st)
+    {
+        return st.is_file() ? st.size() : -1;
+    }
+
+    bool empty() const 
+    { 
+        return path_.size() == root_length(); 
+    }
+
+    bool is_absolute() const 
+    { 
+        return is_absolute_; 
+    }
+
+    bool is_directory() const
+    {
+        return is_directory(status());
+    }
+
+    bool is_directory(StatCache& cache) const
+    {
+        return is_directory(status(cache));
+    }
+
+    static bool is_directory(const FileStatus& st)
+    {
+        return st.is_directory();
+    }
+
+    bool is_file() const
+    {
+        return is_file(status());
+    }
+
+    bool is_file(StatCache& cache) const
+    {
+        return is_file(status(cache));
+    }
+
+    static bool is_file(const FileStatus& st)
+    {
+        return st.is_file();
+    }
+
+    /**
+     * @brief シンボリックリンクを辿った先の属性を1回の stat で取得する
+     * 
+     * @return FileStatus 存在しない場合は type() が FileStatus::NOT_FOUND となる
+     */
+    FileStatus status() const
+    {
+        return query_status(true);
+    }
+
+    /**
+     * @brief status() と同じ。存在しない以外の理由で失敗した場合は ec へエラーを格納する
+     */
+    FileStatus status(std::error_code& ec) const
+    {
+        return query_status(true, ec);
+    }
+
+    /**
+     * @brief status() と同じ。cache に有効なエントリがあればシステムコールを行わない
+     */
+    FileStatus status(StatCache& cache) const;
+
+    /**
+     * @brief シンボリックリンク自身の属性を1回の lstat で取得する
+     * 
+     * @return FileStatus 
+     */
+    FileStatus symlink_status() const
+    {
+        return query_status(false);
+    }
+
+    /**
+     * @brief symlink_status() と同じ。存在しない以外の理由で失敗した場合は ec へエラーを格納する
+     */
+    FileStatus symlink_status(std::error_code& ec) const
+    {
+        return query_status(false, ec);
+    }
+
+    /**
+     * @brief symlink_status() と同じ。cache に有効なエントリがあればシステムコールを行わない
+     */
+    FileStatus symlink_status(StatCache& cache) const;
+
+    /**
+     * @brief 絶対パスを取得する
+     * 
+     * @exception std::system_error 解決できない場合
+     * @return FilePath 
+     */
+    FilePath make_absolute() const
+    {
+        std::error_code ec;
+        FilePath result = make_absolute(ec);
+        if (ec)
+            throw std::system_error(ec, "FilePath::make_absolute()");
+        return result;
+    }
+
+    /**
+     * @brief 絶対パスを取得する (例外を送出せず、失敗した場合は ec へエラーを格納して空のパスを返す)
+     * 
+     * @param ec 失敗時はエラー、成功時はクリアされる
+     * @return FilePath 
+     */
+    FilePath make_absolute(std::error_code& ec) const
+    {
+        FILE_PATH_TRACE(REALPATH);
+#ifdef __unix__
+        char tmp[PATH_MAX];
+        if (realpath(c_str(), tmp) == NULL)
+        {
+            ec = last_error_code();
+            return FilePath();
+        }
+        ec.clear();
+        return FilePath(tmp);
+#else
+        const Win32Path path = win32_path();
+        std::wstring tmp(MAX_PATH, L'\0');
+        DWORD length = GetFullPathNameW(path.c_str(), static_cast<DWORD>(tmp.size()), &tmp[0], NULL);
+        if (length > tmp.size())
+        {
+            // 戻り値は終端の NUL を含めた必要な長さ
+            tmp.resize(length);
+            length = GetFullPathNameW(path.c_str(), static_cast<DWORD>(tmp.size()), &tmp[0], NULL);
+        }
+        if (length == 0 || length > tmp.size())
+        {
+            ec = (length == 0) ? last_error_code() : std::error_code(ERROR_INSUFFICIENT_BUFFER, std::system_category());
+            return FilePath();
+        }
+        ec.clear();
+        return from_win32(tmp.data(), length);
+#endif
+    }
+
+    bool exists() const
+    {
+        return exists(status());
+    }
+
+    bool exists(StatCache& cache) const
+    {
+        return exists(status(cache));
+    }
+
+    static bool exists(const FileStatus& st)
+    {
+        return st.exists();
+    }
+
+    std::string to_str(Platform platform = NATIVE) const
+    {
+        FILE_PATH_COUNT(TO_STR);
+        FILE_PATH_COUNT_COPY(path_);
+        if (platform == platform_)
+            return path_;
+
+        // ドライブのルート (C:\ の '\') も変換する
+        std::string result = path_;
+        const char from = separator();
+        const char to   = (platform == UNIX) ? '/' : '\\';
+        for (std::size_t i = 0; i < result.size(); ++i)
+        {
+            if (result[i] == from)
+                result[i] = to;
+        }
+        return result;
+    }
+
+    /**
+     * @brief 自身のプラットフォーム形式で描画済みのパス文字列を取得する
+     * 
+     * @return const std::string& 内部バッファへの参照 (変更操作を行うまで有効)
+     */
+    const std::string& native() const
+    {
+        return path_;
+    }
+
+    /**
+     * @brief システムコールへそのまま渡せる NULL 終端文字列を取得する
+     * 
+     * @return const char* 内部バッファへのポインタ (変更操作を行うまで有効)
+     */
+    const char* c_str() const
+    {
+        return path_.c_str();
+    }
+
+    /**
+     * @brief 内部バッファを借用する FilePathView を取得する (変更操作を行うまで有効)
+     */
+    FilePathView view() const;
+
+    std::wstring to_wstr(const Platform& platform = NATIVE) const
+    {
+#ifdef __unix__
+        return std::wstring();
+#else
+        if (platform == platform_)
+            return native_;
+        const std::string tmp = to_str(platform);
+        std::wstring result;
+        append_wide(result, tmp.data(), tmp.size());
+        return result;
+#endif
+
+    }
+
+#ifndef __unix__
+    /**
+     * @class Win32Path
+     * @brief win32_path() の戻り値。...W API へ渡す間だけ生存させる (関数の引数に直接渡す)
+     */
+    class Win32Path
+    {
+    public:
+        const wchar_t* c_str() const
+        {
+            return long_.empty() ? native_->c_str() : long_.c_str();
+        }
+
+    private:
+        friend class FilePath;
+
+        const std::wstring* native_;
+        std::wstring long_;
+
+        explicit Win32Path(const std::wstring& native)
+         :  native_(&native), long_()
+        {}
+    };
+
+    /**
+     * @brief ...W API へ渡す UTF-16 のパス (保持している native_ を指すため、呼び出しごとの変換は行わない)
+     * 
+     * MAX_PATH を超える絶対パスの場合に限り "\\?\" を前置した文字列を作る。"\\?\" 付きのパスでは
+     * "." / ".." や '/' が解釈されないため、lexically_normal() した Windows 形式から作る
+     * (Win32 が通常のパスに対して行う正規化と同じ結果となる)。
+     */
+    Win32Path win32_path() const
+    {
+        Win32Path result(native_);
+        if (!is_absolute_ || native_.size() < MAX_PATH - 12)      // CreateDirectoryW の上限が MAX_PATH - 12
+            return result;
+        const std::string normal = lexically_normal().to_str(WINDOWS);
+        result.long_ = L"\\\\?\\";
+        append_wide(result.long_, normal.data(), normal.size());
+        return result;
+    }
+#endif
+
+    /**
+     * @brief ディレクトリ直下のエントリを全て読み込んで返す ("." と ".." は含まない)
+     * 
+     * 大きなディレクトリを走査する場合は、1件ずつ読み出す DirectoryIterator を用いること。
+     * 
+     * @param path 
+     * @return std::vector<FilePath> 
+     */
+    static std::vector<FilePath> directory_iterator(const FilePath& path);
+
+    /**
+     * @brief ディレクトリ直下のエントリを全て読み込んで返す (開けない場合は ec へエラーを格納して空の配列を返す)
+     */
+    static std::vector<FilePath> directory_iterator(const FilePath& path, std::error_code& ec);
+
+    /**
+     * @brief ディレクトリ直下のエントリを全て読み込み、パス文字列と配列を arena 上に置いて返す
+     * 
+     * エントリごとの FilePath の確保を行わず、結果全体を arena.release() で一度に解放できる。
+     * 返す FilePathView は arena が解放されるまで有効である。
+     * 
+     * @param path 
+     * @param arena 結果を格納するアリーナ
+     * @return std::vector<FilePathView, ArenaAllocator<FilePathView> > 
+     */
+    static std::vector<FilePathView, ArenaAllocator<FilePathView> > directory_iterator(const FilePath& path, MonotonicArena& arena);
+
+    /**
+     * @brief 対象ファイルの拡張子を取得する
+     * 
+     * @return std::string 
+     */
+    std::string extension() const
+    {
+        const std::string name = filename();
+        size_t pos = name.find_last_of('.');
+        if (pos == std::string::npos)
+            return "";
+        return name.substr(pos + 1);
+    }
+
+    std::string filename() const
+    {
+        if (empty())
+            return "";
+        return path_.substr(path_.find_last_of(separator()) + 1);
+    }
+
+    /**
+     * @brief 親ディレクトリのパスを取得する (文字列上の操作のみで、システムコールは行わない)
+     * 
+     * 最後のコンポーネントを取り除く。ルートの親はルート自身とし、最後のコンポーネントが
+     * "." または ".." の場合は ".." を連結する (絶対パスの場合はさらに lexically_normal() を適用する)。
+     * 
+     * @return FilePath 
+     */
+    FilePath parent_path() const
+    {
+        FilePath result = *this;
+        if (empty())
+        {
+            if (!is_absolute_)
+                result.append_component("..", 2);
+            return result;
+        }
+
+        const std::size_t pos = filename_position();
+        if (!is_dot(pos, path_.size() - pos) && !is_dot_dot(pos, path_.size() - pos))
+        {
+            result.pop_component();
+            return result;
+        }
+
+        result.append_component("..", 2);
+        return is_absolute_ ? result.lexically_normal() : result;
+    }
+
+    /**
+     * @brief "." / ".." / 重複する区切り文字を1回の走査で取り除いた正規形を取得する (システムコールは行わない)
+     * 
+     * シンボリックリンクは考慮しない。絶対パスのルートより上を指す ".." は取り除き、
+     * 結果が空になる相対パスは "." とする。
+     * 
+     * @return FilePath 
+     */
+    FilePath lexically_normal() const
+    {
+        FilePath result;
+        result.platform_    = platform_;
+        result.is_absolute_ = is_absolute_;
+        result.path_.reserve(path_.size());
+        result.path_.assign(path_, 0, root_length());
+        result.rehash();
+
+        std::size_t poppable = 0;      // result 末尾の ".." 以外のコンポーネント数
+        std::size_t length;
+        for (std::size_t pos = root_length(); next_component(pos, length); pos += length + 1)
+        {
+            if (is_dot(pos, length))
+                continue;
+            if (is_dot_dot(pos, length))
+            {
+                if (poppable > 0)
+                {
+                    result.pop_component();
+                    --poppable;
+                }
+                else if (!is_absolute_)
+                {
+                    result.append_component("..", 2);
+                }
+                continue;
+            }
+            result.append_component(&path_[pos], length);
+            ++poppable;
+        }
+
+        if (result.path_.empty() && !path_.empty())
+            result.append_component(".", 1);
+        return result;
+    }
+
+    /**
+     * @brief base から自身への相対パスを文字列上の操作のみで求める (std::filesystem::path::lexically_relative 相当)
+     * 
+     * ルートが異なる場合や、base が ".." で自身より上へ出る場合は空のパスを返す。
+     * 正規化は行わないため、必要に応じて事前に lexically_normal() を適用すること。
+     * 
+     * @param base 基準となるパス
+     * @return FilePath 
+     */
+    FilePath lexically_relative(const FilePath& base) const
+    {
+        FilePath result;
+        result.platform_ = platform_;
+        if (platform_ != base.platform_ || is_absolute_ != base.is_absolute_ || path_.compare(0, root_length(), base.path_, 0, base.root_length()) != 0)
+            return result;
+
+        std::size_t pos = root_length(), length = 0;
+        std::size_t base_pos = base.root_length(), base_length = 0;
+        bool has = next_component(pos, length);
+        bool base_has = base.next_component(base_pos, base_length);
+        while (has && base_has && path_.compare(pos, length, base.path_, base_pos, base_length) == 0)
+        {
+            pos += length + 1;
+            base_pos += base_length + 1;
+            has = next_component(pos, length);
+            base_has = base.next_component(base_pos, base_length);
+        }
+
+        long up = 0;
+        for (; base_has; base_pos += base_length + 1, base_has = base.next_component(base_pos, base_length))
+        {
+            if (base.is_dot_dot(base_pos, base_length))
+                --up;
+            else if (!base.is_dot(base_pos, base_length))
+                ++up;
+        }
+        if (up < 0)
+            return result;
+        if (up == 0 && !has)
+        {
+            result.append_component(".", 1);
+            return result;
+        }
+
+        for (long i = 0; i < up; ++i)
+            result.append_component("..", 2);
+        if (has)
+            result.append_component(&path_[pos], path_.size() - pos);
+        return result;
+    }
+
+    /**
+     * @brief lexically_relative() の結果が空でなければそれを、空であれば自身を返す
+     * 
+     * @param base 基準となるパス
+     * @return FilePath 
+     */
+    FilePath lexically_proximate(const FilePath& base) const
+    {
+        FilePath result = lexically_relative(base);
+        return result.empty() ? *this : result;
+    }
+
+    bool remove_file() const
+    {
+        FILE_PATH_TRACE(REMOVE);
+#ifdef __unix__
+        return std::remove(c_str()) == 0;
+#else
+        return DeleteFileW(win32_path().c_str()) != 0;
+#endif
+    }
+
+    bool remove_file(std::error_code& ec) const
+    {
+        return report(remove_file(), ec);
+    }
+
+    bool resize_file(size_t target_length)
+    {
+#ifdef __unix__
+        return truncate(c_str(), (off_t)target_length) == 0;
+#else
+        HANDLE handle = CreateFileW(win32_path().c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        size.QuadPart = (LONGLONG)target_length;
+        if (SetFilePointerEx(handle, size, NULL, FILE_BEGIN) == 0)
+        {
+            CloseHandle(handle);
+            return false;
+        }
+        if (SetEndOfFile(handle) == 0)
+        {
+            CloseHandle(handle);
+            return false;
+        }
+        CloseHandle(handle);
+        return true;
+#endif
+    }
+
+    bool resize_file(size_t target_length, std::error_code& ec)
+    {
+        return report(resize_file(target_length), ec);
+    }
+
+    /**
+     * @brief preallocate() の動作
+     */
+    enum PreallocateMode
+    {
+        EXTEND = 0,                     /**< 領域を確保し、必要であればファイルサイズを offset + size まで伸ばす */
+        KEEP_SIZE,                      /**< 領域のみを確保し、ファイルサイズは変えない */
+        PUNCH_HOLE                      /**< [offset, offset + size) の領域を解放して穴にする (ファイルサイズは変えない) */
+    };
+
+    /**
+     * @brief ファイルの [offset, offset + size) にディスク上の領域を確保する (PUNCH_HOLE 以外ではファイルが存在しなければ作成する)
+     * 
+     * resize_file() は疎な穴を作るだけなので、後の書き込みで断片化やページフォルトが発生する。
+     * 書き込み前に連続した領域が必要な場合はこちらを用いる。POSIX では fallocate を用い、
+     * 対応しないファイルシステムでは EXTEND に限り posix_fallocate で代替する。
+     * Windows では FILE_ALLOCATION_INFO で確保し、PUNCH_HOLE は FSCTL_SET_ZERO_DATA で行う
+     * (SetFileValidData は特権が必要なため用いない)。EXTEND / KEEP_SIZE は既存の領域やファイルサイズを縮めることはない。
+     * 
+     * @param size 確保するバイト数
+     * @param mode 動作
+     * @param offset 確保を開始する位置
+     * @return bool 
+     */
+    bool preallocate(uint64_t size, PreallocateMode mode = EXTEND, uint64_t offset = 0) const
+    {
+#ifdef __unix__
+        const int fd = ::open(c_str(), O_WRONLY | O_CLOEXEC | (mode == PUNCH_HOLE ? 0 : O_CREAT), 0644);
+        if (fd < 0)
+            return false;
+        int ret = -1;
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+        int flags = 0;
+        if (mode == KEEP_SIZE)
+            flags = FALLOC_FL_KEEP_SIZE;
+        else if (mode == PUNCH_HOLE)
+            flags = FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE;
+        ret = fallocate(fd, flags, static_cast<off_t>(offset), static_cast<off_t>(size));
+        if (ret != 0 && errno == EOPNOTSUPP && mode == EXTEND)
+        {
+            errno = posix_fallocate(fd, static_cast<off_t>(offset), static_cast<off_t>(size));     // errno を設定せずにエラー番号を返す
+            ret = (errno == 0) ? 0 : -1;
+        }
+#else
+        if (mode == EXTEND)
+        {
+            errno = posix_fallocate(fd, static_cast<off_t>(offset), static_cast<off_t>(size));
+            ret = (errno == 0) ? 0 : -1;
+        }
+        else
+            errno = EOPNOTSUPP;
+#endif
+        const int error = errno;
+        ::close(fd);
+        errno = error;
+        return ret == 0;
+#else
+        HANDLE handle = CreateFileW(win32_path().c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, mode == PUNCH_HOLE ? OPEN_EXISTING : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (handle == INVALID_HANDLE_VALUE)
+            return false;
+
+        bool ok;
+        if (mode == PUNCH_HOLE)
+        {
+            DWORD bytes;
+            FILE_ZERO_DATA_INFORMATION zero;
+            zero.FileOffset.QuadPart      = static_cast<LONGLONG>(offset);
+            zero.BeyondFinalZero.QuadPart = static_cast<LONGLONG>(offset + size);
+            ok = DeviceIoControl(handle, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &bytes, NULL) != 0
+              && DeviceIoControl(handle, FSCTL_SET_ZERO_DATA, &zero, sizeof(zero), NULL, 0, &bytes, NULL) != 0;
+        }
+        else
+        {
+            // FileAllocationInfo は現在より小さい値を渡すと切り詰めるため、確保済みの領域を超える場合に限り設定する
+            const LONGLONG last = static_cast<LONGLONG>(offset + size);
+            FILE_STANDARD_INFO current;
+            ok = GetFileInformationByHandleEx(handle, FileStandardInfo, &current, sizeof(current)) != 0;
+            if (ok && current.AllocationSize.QuadPart < last)
+            {
+                FILE_ALLOCATION_INFO allocation;
+                allocation.AllocationSize.QuadPart = last;
+                ok = SetFileInformationByHandle(handle, FileAllocationInfo, &allocation, sizeof(allocation)) != 0;
+            }
+            if (ok && mode == EXTEND && current.EndOfFile.QuadPart < last)
+            {
+                FILE_END_OF_FILE_INFO end;
+                end.EndOfFile.QuadPart = last;
+                ok = SetFileInformationByHandle(handle, FileEndOfFileInfo, &end, sizeof(end)) != 0;
+            }
+        }
+        CloseHandle(handle);
+        return ok;
+#endif
+    }
+
+    bool preallocate(uint64_t size, PreallocateMode mode, uint64_t offset, std::error_code& ec) const
+    {
+        return report(preallocate(size, mode, offset), ec);
+    }
+
+    /**
+     * @brief ファイルの内容を to へ複製する
+     * 
+     * Linux では reflink (ioctl FICLONE) 、copy_file_range 、sendfile の順にカーネル内での複製を試み、
+     * いずれも使えない場合に限り、アラインされた大きなバッファでの read / write へ切り替える。
+     * Windows では CopyFileExW を用いる。パーミッションは元のファイルに合わせる。
+     * to が自身 (またはそのハードリンク) であれば内容を切り詰めずに失敗する (errno は EINVAL) 。
+     * 
+     * @param to 複製先のパス
+     * @param overwrite 複製先が存在する場合に上書きするか否か
+     * @return bool 
+     */
+    bool copy_file(const FilePath& to, bool overwrite = false) const
+    {
+        FILE_PATH_TRACE(COPY_FILE);
+#ifdef __unix__
+        const int in = ::open(c_str(), O_RDONLY | O_CLOEXEC);
+        if (in < 0)
+            return false;
+        struct stat st;
+        if (fstat(in, &st) != 0)
+        {
+            const int error = errno;
+            ::close(in);
+            errno = error;
+            return false;
+        }
+        if (!S_ISREG(st.st_mode))
+        {
+            ::close(in);
+            errno = S_ISDIR(st.st_mode) ? EISDIR : EINVAL;
+            return false;
+        }
+        // O_TRUNC で開くと複製元と同じファイルだった場合に内容を失うため、確かめてから切り詰める
+        const int out = ::open(to.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (overwrite ? 0 : O_EXCL), st.st_mode & 07777);
+        if (out < 0)
+        {
+            ::close(in);
+            return false;
+        }
+        struct stat target;
+        int error = 0;
+        if (fstat(out, &target) != 0)
+            error = errno;
+        else if (target.st_dev == st.st_dev && target.st_ino == st.st_ino)
+            error = EINVAL;
+        if (error != 0)
+        {
+            ::close(in);
+            ::close(out);
+            errno = error;
+            return false;
+        }
+
+        const bool ok = ftruncate(out, 0) == 0
+            && fchmod(out, st.st_mode & 07777) == 0     // 既存のファイルや umask で変わったパーミッションを揃える
+            && copy_contents(in, out, static_cast<uint64_t>(st.st_size));
+        ::close(in);
+        if (::close(out) != 0 || !ok)
+        {
+            error = errno;
+            unlink(to.c_str());
+            errno = error;
+            return false;
+        }
+        return true;
+#else
+        return CopyFileExW(win32_path().c_str(), to.win32_path().c_str(), NULL, NULL, NULL, overwrite ? 0 : COPY_FILE_FAIL_IF_EXISTS) != 0;
+#endif
+    }
+
+    bool copy_file(const FilePath& to, bool overwrite, std::error_code& ec) const
+    {
+        return report(copy_file(to, overwrite), ec);
+    }
+
+    /**
+     * @brief to へ名前を変更する (同一ファイルシステム内のみ。to が存在するファイルであれば置き換える)
+     * 
+     * @param to 変更後のパス
+     * @return bool 
+     */
+    bool rename(const FilePath& to) const
+    {
+        FILE_PATH_TRACE(RENAME);
+#ifdef __unix__
+        return ::rename(c_str(), to.c_str()) == 0;
+#else
+        return MoveFileExW(win32_path().c_str(), to.win32_path().c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#endif
+    }
+
+    bool rename(const FilePath& to, std::error_code& ec) const
+    {
+        return report(rename(to), ec);
+    }
+
+    /**
+     * @brief to へ移動する。rename() がファイルシステムをまたぐために失敗した場合は、
+     *        copy_file() (ディレクトリであれば copy_tree()) で複製した後に元を削除する
+     * 
+     * @param to 移動先のパス
+     * @return bool 
+     */
+    bool move(const FilePath& to) const
+    {
+#ifdef __unix__
+        if (rename(to))
+            return true;
+        if (errno != EXDEV)
+            return false;
+        if (is_directory())
+        {
+            if (!copy_tree(*this, to))
+                return false;
+            const FileOperationResult removed = remove_all(*this);
+            if (!removed.ok())
+                set_last_error(removed.error);
+            return removed.ok();
+        }
+        return copy_file(to, true) && remove_file();
+#else
+        FILE_PATH_TRACE(RENAME);
+        return MoveFileExW(win32_path().c_str(), to.win32_path().c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED) != 0;
+#endif
+    }
+
+    bool move(const FilePath& to, std::error_code& ec) const
+    {
+        return report(move(to), ec);
+    }
+
+    /**
+     * @brief from 配下を to へ再帰的に複製する (DirectoryWalker で並列に走査し、各ファイルは copy_file() で複製する)
+     * 
+     * to が存在しなければ作成する。シンボリックリンクは options.follow_symlinks が false の場合は
+     * リンクとして複製し、特殊ファイルは複製しない。
+     * 
+     * @param from 複製元のディレクトリ
+     * @param to 複製先のディレクトリ
+     * @param options 走査の設定
+     * @param overwrite 複製先に存在するファイルを上書きするか否か
+     * @return bool 全てのエントリを複製できた場合は true
+     */
+    static bool copy_tree(const FilePath& from, const FilePath& to, const WalkOptions& options = WalkOptions(), bool overwrite = false);
+
+    /**
+     * @brief ファイル全体を読み取り専用でメモリへマップする (失敗した場合は is_open() が false の MappedFile を返す)
+     * 
+     * アクセスパターンのヒントは返した MappedFile の advise() / prefetch() で与えるか、MappedFile を直接構築する。
+     * 
+     * @param huge_pages 可能であれば透過的ヒュージページを用いる
+     * @return MappedFile 
+     */
+    MappedFile map_readonly(bool huge_pages = false) const;
+
+    /**
+     * @brief 取得済みの status (status() や DirectoryEntry::status() の結果) のサイズを再利用してマップする
+     * 
+     * @param status 自身の属性
+     * @param huge_pages 可能であれば透過的ヒュージページを用いる
+     * @return MappedFile 
+     */
+    MappedFile map_readonly(const FileStatus& status, bool huge_pages = false) const;
+
+    /**
+     * @brief カレントディレクトリを取得する
+     * 
+     * @exception std::system_error 取得できない場合
+     * @return FilePath 
+     */
+    static FilePath current_path()
+    {
+        std::error_code ec;
+        FilePath result = current_path(ec);
+        if (ec)
+            throw std::system_error(ec, "FilePath::current_path()");
+        return result;
+    }
+
+    /**
+     * @brief カレントディレクトリを取得する (例外を送出せず、失敗した場合は ec へエラーを格納して空のパスを返す)
+     */
+    static FilePath current_path(std::error_code& ec)
+    {
+#ifdef __unix__
+        char tmp[PATH_MAX];
+        if (getcwd(tmp, PATH_MAX) == NULL)
+        {
+            ec = last_error_code();
+            return FilePath();
+        }
+        ec.clear();
+        return FilePath(tmp);
+#else
+        std::wstring tmp(MAX_PATH, L'\0');
+        DWORD length = GetCurrentDirectoryW(static_cast<DWORD>(tmp.size()), &tmp[0]);
+        if (length > tmp.size())
+        {
+            // 戻り値は終端の NUL を含めた必要な長さ
+            tmp.resize(length);
+            length = GetCurrentDirectoryW(static_cast<DWORD>(tmp.size()), &tmp[0]);
+        }
+        if (length == 0 || length > tmp.size())
+        {
+            ec = (length == 0) ? last_error_code() : std::error_code(ERROR_INSUFFICIENT_BUFFER, std::system_category());
+            return FilePath();
+        }
+        ec.clear();
+        return from_win32(tmp.data(), length);
+#endif
+    }
+
+    /**
+     * @brief 複数のパスの属性をまとめて取得する
+     * 
+     * Linux では statx 要求を io_uring へまとめて投入し、数回のシステムコールで全件を処理する。
+     * io_uring が使えない環境 (カーネルが古い, seccomp で禁止されている等) や
+     * 他のプラットフォームでは、WorkStealingPool 上で stat を並列に呼び出す。
+     * 
+     * @param paths 対象のパス
+     * @param follow_symlink false の場合は symlink_status() 相当となる
+     * @return std::vector<FileStatus> paths と同じ順序の結果
+     */
+    static std::vector<FileStatus> status_batch(const std::vector<FilePath>& paths, bool follow_symlink = true);
+
+    /**
+     * @brief AsyncFileSystem::instance() のワーカー上で属性を取得する (呼び出したスレッドはブロックしない)
+     * 
+     * @param follow_symlink false の場合は symlink_status() 相当となる
+     * @return std::future<FileStatus> 失敗した場合もエラーを格納した FileStatus を返す
+     */
+    std::future<FileStatus> async_status(bool follow_symlink = true) const;
+
+    /**
+     * @brief AsyncFileSystem::instance() のワーカー上で remove_file() を実行する
+     * 
+     * @return std::future<std::error_code> 成功した場合は空のエラーコード
+     */
+    std::future<std::error_code> async_remove() const;
+
+    /**
+     * @brief AsyncFileSystem::instance() のワーカー上で直下のエントリを列挙する
+     * 
+     * @return std::future<std::vector<FilePath> > 開けなかった場合、get() は std::system_error を送出する
+     */
+    std::future<std::vector<FilePath> > async_list() const;
+
+    /**
+     * @brief AsyncFileSystem::instance() のワーカー上で copy_file() を実行する
+     * 
+     * @return std::future<std::error_code> 成功した場合は空のエラーコード
+     */
+    std::future<std::error_code> async_copy(const FilePath& to, bool overwrite = false) const;
+
+    /**
+     * @brief root 以下を複数スレッドで再帰的に走査し、各エントリについて visitor を呼び出す
+     * 
+     * サブディレクトリはワークスティーリング方式のキューでスレッド間に分配される。
+     * visitor は複数のスレッドから同時に呼び出されるため、スレッドセーフでなければならない。
+     * visitor がディレクトリに対して false を返した場合、その配下は走査しない。
+     * 開けないディレクトリは読み飛ばし、エラーとしては報告しない。
+     * 
+     * @param root 走査を開始するディレクトリ
+     * @param visitor bool(const DirectoryEntry& entry, int depth) (depth は root 直下が 0)
+     * @param threads ワーカースレッド数 (0 の場合はコア数)
+     */
+    static void walk(const FilePath& root, const std::function<bool(const DirectoryEntry&, int)>& visitor, unsigned threads = 0);
+
+    static void walk(const FilePath& root, const std::function<bool(const DirectoryEntry&, int)>& visitor, const WalkOptions& options);
+
+    /**
+     * @brief pattern に一致するパスを列挙する (Glob(pattern).expand(base) の省略形)
+     * 
+     * @param pattern "*.log" や "logs/2026-*" などのパターン (記法は Glob を参照)
+     * @param base 相対パターンの起点 (空の場合はカレントディレクトリ)
+     * @param threads ワーカースレッド数 (0 の場合はコア数)
+     * @return std::vector<FilePath> 昇順に整列した結果
+     */
+    static std::vector<FilePath> glob(const std::string& pattern, const FilePath& base = FilePath(), unsigned threads = 0);
+
+    /**
+     * @brief root 以下の論理サイズ・割り当て済み容量・エントリ数をディレクトリごとに集計する (du 相当)
+     * 
+     * walk と同じくディレクトリ単位のタスクを複数スレッドで処理し、各エントリの属性は
+     * 親ディレクトリの fd からの fstatat 1回 (Windows では FindNextFile の結果のみ) で取得する。
+     * シンボリックリンクは辿らず、リンク自身を数える。
+     * 
+     * @param root 集計するディレクトリ (ディレクトリでない場合はそのファイル1件の集計を返す)
+     * @return DiskUsage root の集計。children に options.max_depth までの各ディレクトリの集計を持つ
+     */
+    static DiskUsage disk_usage(const FilePath& root, const DiskUsageOptions& options = DiskUsageOptions());
+
+    static bool create_directory(const FilePath &path)
+    {
+        FILE_PATH_TRACE(CREATE_DIRECTORY);
+#ifdef __unix__
+        return mkdir(path.c_str(), S_IRWXU) == 0;
+#else
+        return CreateDirectoryW(path.win32_path().c_str(), NULL) != 0;
+#endif
+    }
+
+    static bool create_directory(const FilePath &path, std::error_code& ec)
+    {
+        return report(create_directory(path), ec);
+    }
+
+    /**
+     * @brief path と、存在しない親ディレクトリをまとめて作成する
+     * 
+     * 通常は親が既に存在するため、まず末端の作成を試み、ENOENT となった場合に限り
+     * 存在する祖先まで遡ってから順に作成する。path が既にディレクトリであれば count == 0 で成功とする。
+     * 
+     * @param path 作成するディレクトリ
+     * @return FileOperationResult 
+     */
+    static FileOperationResult create_directories(const FilePath &path)
+    {
+        FileOperationResult result;
+        std::string buffer(path.path_);
+        std::vector<std::size_t> ends;
+        for (std::size_t pos = path.root_length(), length; path.next_component(pos, length); pos += length + 1)
+            ends.push_back(pos + length);
+
+        // 末端から遡り、作成できた (または既に存在する) 祖先の位置を探す
+        std::size_t created = ends.size();
+        int error = 0;
+        while (created > 0)
+        {
+            error = make_directory(buffer, ends[created - 1], path.separator());
+            if (!is_not_found(error))
+                break;
+            --created;
+        }
+        FilePath existing;
+        if (created > 0)
+            existing.set(buffer.data(), ends[created - 1], path.platform_);
+        if (error == 0 && created > 0)
+        {
+            ++result.count;
+        }
+        else if (error != 0 && !(is_already_exists(error) && existing.is_directory()))
+        {
+            result.failures = 1;
+            result.error = error;
+            result.error_path = buffer.substr(0, ends[std::max<std::size_t>(created, 1) - 1]);
+            return result;
+        }
+
+        for (std::size_t i = created; i < ends.size(); ++i)
+        {
+            error = make_directory(buffer, ends[i], path.separator());
+            if (error == 0)
+            {
+                ++result.count;
+            }
+            else if (!is_already_exists(error))
+            {
+                result.failures = 1;
+                result.error = error;
+                result.error_path = buffer.substr(0, ends[i]);
+                return result;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief path 配下を全て削除する (シンボリックリンクは辿らずリンク自体を削除する)
+     * 
+     * ディレクトリ1つを1タスクとして WorkStealingPool で並列に処理し、エントリは親ディレクトリの
+     * DirectoryHandle からの unlinkat で削除する。ディレクトリ自身は配下が全て削除された時点で削除する。
+     * 失敗したエントリがあっても残りの削除は続ける。path が存在しない場合は count == 0 で成功とする。
+     * 
+     * @param path 削除するファイルまたはディレクトリ
+     * @param threads ワーカースレッド数 (0 の場合はコア数)
+     * @return FileOperationResult 
+     */
+    static FileOperationResult remove_all(const FilePath &path, unsigned threads = 0);
+
+    /**
+     * @fn application_path
+     * @brief 実行ファイルの絶対パスを取得するメソッド
+     * 
+     * @exception std::system_error 取得できない場合
+     * @return FilePath 実行ファイルの絶対パス
+     */
+    static FilePath application_path()
+    {
+        std::error_code ec;
+        FilePath result = application_path(ec);
+        if (ec)
+            throw std::system_error(ec, "FilePath::application_path()");
+        return result;
+    }
+
+    /**
+     * @brief 実行ファイルの絶対パスを取得する (例外を送出せず、失敗した場合は ec へエラーを格納して空のパスを返す)
+     */
+    static FilePath application_path(std::error_code& ec)
+    {
+#ifdef __unix__
+        char tmp[PATH_MAX];
+        const ssize_t length = readlink("/proc/self/exe", tmp, sizeof(tmp) - 1);
+        if (length == -1)
+        {
+            ec = last_error_code();
+            return FilePath();
+        }
+        tmp[length] = '\0';    // readlink は NUL 終端しない
+        ec.clear();
+        return FilePath(tmp);
+#else
+        // 切り詰められた場合はバッファの長さと同じ値が返るため、収まるまで広げる
+        std::wstring tmp(MAX_PATH, L'\0');
+        DWORD length;
+        while ((length = GetModuleFileNameW(NULL, &tmp[0], static_cast<DWORD>(tmp.size()))) == tmp.size() && tmp.size() < 32768)
+            tmp.resize(tmp.size() * 2);
+        if (length == 0 || length == tmp.size())
+        {
+            ec = (length == 0) ? last_error_code() : std::error_code(ERROR_INSUFFICIENT_BUFFER, std::system_category());
+            return FilePath();
+        }
+        ec.clear();
+        return from_win32(tmp.data(), length);
+#endif      
+    }
+
+private:
+    friend class FilePathView;
+    friend class DirectoryEntry;
+    friend class DirectoryHandle;
+    friend class DirectoryIterator;
+    friend class DirectoryRemover;
+    friend class DirectorySnapshot;
+    friend class SnapshotBuilder;
+    friend class PathTable;
+    friend class AsyncFileSystem;
+    friend class Glob;
+    template<std::size_t, Platform> friend class StaticFilePath;
+
+    /**
+     * 全コンポーネントを platform_ の区切り文字 ('/' または '\\') で連結した単一のバッファ。
+     * そのまま to_str() / c_str() の結果となるため、システムコールの呼び出しごとに
+     * 文字列を組み立て直すことはない。
+     * 絶対パスの場合は先頭にルート ("/" または "C:\\") を含み、重複する区切り文字は
+     * set() の時点で除去される。コンポーネント境界は保持せず、必要なときに区切り文字を
+     * 走査して求める。オブジェクトサイズは std::string 1個 + ハッシュ値 8 バイト + 8 バイト
+     * (64bit libstdc++ で 48 バイト) で、ヒープ確保はパス全体で高々1回
+     * (SSO に収まる 15 文字以下なら 0 回) となる。
+     * Windows では ...W API にそのまま渡せる UTF-16 表現 native_ も合わせて保持する。
+     */
+    std::string path_;
+    uint64_t hash_;                     /**< path_ の FNV-1a ハッシュ値 (path_ の変更と同時に更新する) */
+    bool is_absolute_;                  /**< */
+    Platform platform_;
+#ifndef __unix__
+    std::wstring native_;               /**< path_ を UTF-16 へ変換したもの (hash_ と同時に差分だけ更新する) */
+#endif
+
+    static const uint64_t HASH_BASIS = 14695981039346656037ULL;
+    static const uint64_t HASH_PRIME = 1099511628211ULL;
+
+    static uint64_t hash_bytes(const char* data, std::size_t size, uint64_t hash)
+    {
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= HASH_PRIME;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief path_[from, size()) が追記された分だけ hash_ を更新する (FNV-1a は先頭から逐次的に計算できる)
+     */
+    void extend_hash(std::size_t from)
+    {
+        hash_ = hash_bytes(path_.data() + from, path_.size() - from, hash_);
+#ifndef __unix__
+        append_wide(native_, path_.data() + from, path_.size() - from);
+#endif
+    }
+
+    void rehash()
+    {
+        hash_ = hash_bytes(path_.data(), path_.size(), HASH_BASIS);
+#ifndef __unix__
+        native_.clear();
+        append_wide(native_, path_.data(), path_.size());
+#endif
+    }
+
+#ifndef __unix__
+    /**
+     * @brief UTF-8 の data[0, size) を UTF-16 へ変換して out に追記する (UTF-16 の長さは UTF-8 のバイト数以下のため、1回の呼び出しで済む)
+     */
+    static void append_wide(std::wstring& out, const char* data, std::size_t size)
+    {
+        if (size == 0)
+            return;
+        const std::size_t from = out.size();
+        out.resize(from + size);
+        const int length = MultiByteToWideChar(CP_UTF8, 0, data, static_cast<int>(size), &out[from], static_cast<int>(size));
+        out.resize(from + static_cast<std::size_t>(std::max(length, 0)));
+    }
+
+    /**
+     * @brief UTF-16 の data[0, size) を UTF-8 へ変換して out に追記する (1文字あたり高々3バイト)
+     */
+    static void append_narrow(std::string& out, const wchar_t* data, std::size_t size)
+    {
+        if (size == 0)
+            return;
+        const std::size_t from = out.size();
+        out.resize(from + size * 3);
+        const int length = WideCharToMultiByte(CP_UTF8, 0, data, static_cast<int>(size), &out[from], static_cast<int>(size * 3), NULL, NULL);
+        out.resize(from + static_cast<std::size_t>(std::max(length, 0)));
+    }
+
+    /**
+     * @brief Win32 API が返したパスから FilePath を生成する (先頭の "\\?\" は取り除く)
+     */
+    static FilePath from_win32(const wchar_t* data, std::size_t size)
+    {
+        if (size >= 4 && data[0] == L'\\' && data[1] == L'\\' && data[2] == L'?' && data[3] == L'\\')
+        {
+            data += 4;
+            size -= 4;
+        }
+        std::string utf8;
+        append_narrow(utf8, data, size);
+        FilePath path;
+        path.set(utf8);
+        return path;
+    }
+#endif
+
+    char separator() const
+    {
+        return (platform_ == UNIX) ? '/' : '\\';
+    }
+
+    /**
+     * @brief buffer のうち先頭から end までをディレクトリとして作成する (一時的に end を NUL 終端にする)
+     * 
+     * @return int 成功時は 0 、失敗時はエラー番号 (POSIX では errno 、Windows では GetLastError)
+     */
+    static int make_directory(std::string& buffer, std::size_t end, char separator)
+    {
+        const bool terminate = end < buffer.size();
+        if (terminate)
+            buffer[end] = '\0';
+        FILE_PATH_TRACE(CREATE_DIRECTORY);
+#ifdef __unix__
+        const int error = (mkdir(buffer.c_str(), S_IRWXU) == 0) ? 0 : errno;
+#else
+        const int error = (CreateDirectoryW(FilePath(buffer.c_str()).win32_path().c_str(), NULL) != 0) ? 0 : static_cast<int>(GetLastError());
+#endif
+        if (terminate)
+            buffer[end] = separator;
+        return error;
+    }
+
+    static bool is_not_found(int error)
+    {
+#ifdef __unix__
+        return error == ENOENT;
+#else
+        return error == ERROR_PATH_NOT_FOUND || error == ERROR_FILE_NOT_FOUND;
+#endif
+    }
+
+    static bool is_already_exists(int error)
+    {
+#ifdef __unix__
+        return error == EEXIST;
+#else
+        return error == ERROR_ALREADY_EXISTS;
+#endif
+    }
+
+    static int last_error()
+    {
+#ifdef __unix__
+        return errno;
+#else
+        return static_cast<int>(GetLastError());
+#endif
+    }
+
+    static void set_last_error(int error)
+    {
+#ifdef __unix__
+        errno = error;
+#else
+        SetLastError(static_cast<DWORD>(error));
+#endif
+    }
+
+#ifdef __unix__
+    /**
+     * @brief in の先頭から size バイト (または EOF まで) を out へ書き込む。
+     *        カーネル内で完結する方法から順に試し、未対応であれば次の方法へ切り替える
+     */
+    static bool copy_contents(int in, int out, uint64_t size)
+    {
+#if defined(__linux__) && defined(FICLONE)
+        if (ioctl(out, FICLONE, in) == 0)
+            return true;
+#endif
+        uint64_t copied = 0;
+#if defined(__linux__) && defined(__NR_copy_file_range)
+        while (copied < size)
+        {
+            const ssize_t ret = syscall(__NR_copy_file_range, in, NULL, out, NULL, static_cast<std::size_t>(std::min<uint64_t>(size - copied, 1u << 30)), 0u);
+            if (ret > 0)
+            {
+                copied += static_cast<uint64_t>(ret);
+                continue;
+            }
+            if (ret == 0)
+                return true;
+            if (errno == EINTR)
+                continue;
+            if (copied > 0 || (errno != ENOSYS && errno != EXDEV && errno != EINVAL && errno != EOPNOTSUPP && errno != EPERM))
+                return false;
+            break;
+        }
+        if (copied >= size)
+            return true;
+#endif
+#ifdef __linux__
+        while (copied < size)
+        {
+            const ssize_t ret = sendfile(out, in, NULL, static_cast<std::size_t>(std::min<uint64_t>(size - copied, 1u << 30)));
+            if (ret > 0)
+            {
+                copied += static_cast<uint64_t>(ret);
+                continue;
+            }
+            if (ret == 0)
+                return true;
+            if (errno == EINTR)
+                continue;
+            if (copied > 0 || (errno != ENOSYS && errno != EINVAL))
+                return false;
+            break;
+        }
+        if (copied >= size)
+            return true;
+#endif
+        return copy_buffered(in, out);
+    }
+
+    /**
+     * @brief ページ境界にアラインした 1MiB のバッファで現在位置から EOF まで複製する
+     */
+    static bool copy_buffered(int in, int out)
+    {
+        const std::size_t buffer_size = 1 << 20;
+        void* memory = NULL;
+        if (posix_memalign(&memory, 4096, buffer_size) != 0)
+            return false;
+        std::unique_ptr<char, void (*)(void*)> buffer(static_cast<char*>(memory), &std::free);
+
+        for (;;)
+        {
+            const ssize_t length = read(in, buffer.get(), buffer_size);
+            if (length == 0)
+                return true;
+            if (length < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            for (ssize_t written = 0; written < length;)
+            {
+                const ssize_t ret = write(out, buffer.get() + written, static_cast<std::size_t>(length - written));
+                if (ret < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    return false;
+                }
+                written += ret;
+            }
+        }
+    }
+#endif
+
+    FileStatus query_status(bool follow_symlink) const
+    {
+        FILE_PATH_TRACE(STAT);
+#ifdef __unix__
+        struct stat st;
+        const int ret = follow_symlink ? stat(c_str(), &st) : lstat(c_str(), &st);
+        if (ret != 0)
+            return FileStatus::from_errno(errno);
+        return FileStatus(st);
+#else
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExW(win32_path().c_str(), GetFileExInfoStandard, &data))
+        {
+            const DWORD error = GetLastError();
+            return FileStatus((error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND) ? FileStatus::NOT_FOUND : FileStatus::NONE);
+        }
+        return FileStatus(data.dwFileAttributes, data.ftLastWriteTime, data.nFileSizeHigh, data.nFileSizeLow, follow_symlink);
+#endif
+    }
+
+    FileStatus query_status(bool follow_symlink, std::error_code& ec) const
+    {
+        const FileStatus st = query_status(follow_symlink);
+        if (st.type() == FileStatus::NONE)
+            ec = last_error_code();
+        else
+            ec.clear();
+        return st;
+    }
+
+    /**
+     * @brief 直前のシステムコールのエラー (POSIX では errno 、Windows では GetLastError) を std::error_code へ変換する
+     */
+    static std::error_code last_error_code()
+    {
+#ifdef __unix__
+        return std::error_code(errno, std::generic_category());
+#else
+        return std::error_code(static_cast<int>(GetLastError()), std::system_category());
+#endif
+    }
+
+    /**
+     * @brief bool を返す操作の結果を ec へ反映する (失敗したのにエラー番号が残っていなければ io_error とする)
+     */
+    static bool report(bool ok, std::error_code& ec)
+    {
+        if (ok)
+            ec.clear();
+        else if (!(ec = last_error_code()))
+            ec = std::make_error_code(std::errc::io_error);
+        return ok;
+    }
+
+    std::size_t root_length() const
+    {
+        if (!is_absolute_)
+            return 0;
+        return (platform_ == UNIX) ? 1 : 3;
+    }
+
+    void append_component(const char* name, std::size_t length)
+    {
+        FILE_PATH_TRACE_GROWTH(path_);
+        const std::size_t from = path_.size();
+        if (path_.size() > root_length())
+            path_ += separator();
+        path_.append(name, length);
+        extend_hash(from);
+    }
+
+    void append_components(const FilePath& other)
+    {
+        if (other.empty())
+            return;
+        FILE_PATH_TRACE_GROWTH(path_);
+        const std::size_t from = path_.size();
+        if (path_.size() > root_length())
+            path_ += separator();
+        path_.append(other.path_, other.root_length(), std::string::npos);
+        extend_hash(from);
+    }
+
+    /**
+     * 区切り文字の走査を一度に行うブロック長。AVX2 / SSE2 / NEON が使える場合は
+     * ベクトル比較と movemask で1ブロックを数命令で処理し、それ以外はスカラーでビットマスクを組み立てる。
+     */
+#if defined(__AVX2__)
+    static const std::size_t SEPARATOR_BLOCK = 32;
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || (defined(__ARM_NEON) && defined(__aarch64__))
+    static const std::size_t SEPARATOR_BLOCK = 16;
+#else
+    static const std::size_t SEPARATOR_BLOCK = 32;
+#endif
+
+    /**
+     * @brief data[0, length) のうち区切り文字である位置のビットを立てたマスクを返す (length <= SEPARATOR_BLOCK)
+     */
+    static uint32_t separator_mask(const char* data, std::size_t length, Platform platform)
+    {
+        if (length == SEPARATOR_BLOCK)
+        {
+#if defined(__AVX2__)
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+            __m256i hit = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('/'));
+            if (platform == WINDOWS)
+                hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\\')));
+            return static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+            __m128i hit = _mm_cmpeq_epi8(block, _mm_set1_epi8('/'));
+            if (platform == WINDOWS)
+                hit = _mm_or_si128(hit, _mm_cmpeq_epi8(block, _mm_set1_epi8('\\')));
+            return static_cast<uint32_t>(_mm_movemask_epi8(hit));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+            const uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(data));
+            uint8x16_t hit = vceqq_u8(block, vdupq_n_u8('/'));
+            if (platform == WINDOWS)
+                hit = vorrq_u8(hit, vceqq_u8(block, vdupq_n_u8('\\')));
+            // 各バイトの比較結果を1bitへ畳み込む (NEON には movemask がない)
+            static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+            const uint8x16_t bits = vandq_u8(hit, vld1q_u8(weights));
+            return static_cast<uint32_t>(vaddv_u8(vget_low_u8(bits))) | (static_cast<uint32_t>(vaddv_u8(vget_high_u8(bits))) << 8);
+#endif
+        }
+
+        uint32_t mask = 0;
+        for (std::size_t i = 0; i < length; ++i)
+        {
+            if (data[i] == '/' || (platform == WINDOWS && data[i] == '\\'))
+                mask |= static_cast<uint32_t>(1) << i;
+        }
+        return mask;
+    }
+
+    static unsigned lowest_bit(uint32_t mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+    }
+
+    /**
+     * @brief data[pos, size) の中で最初の区切り文字の位置を返す (見つからない場合は size)
+     */
+    static std::size_t find_separator(const char* data, std::size_t pos, std::size_t size, Platform platform)
+    {
+        for (; pos < size; pos += SEPARATOR_BLOCK)
+        {
+            const uint32_t mask = separator_mask(data + pos, std::min<std::size_t>(+SEPARATOR_BLOCK, size - pos), platform);
+            if (mask != 0)
+                return pos + lowest_bit(mask);
+        }
+        return size;
+    }
+
+    /**
+     * @brief ドライブレター付きの絶対パス ("C:\\" または "C:/") で始まるか否か
+     */
+    static bool has_drive(const char* data, std::size_t size)
+    {
+        return size >= 3 && (static_cast<unsigned char>(data[0]) < 0x80) && std::isalpha(static_cast<unsigned char>(data[0])) && data[1] == ':' && (data[2] == '\\' || data[2] == '/');
+    }
+
+    /**
+     * @brief origin[pos, size) をコンポーネントに分解して追記する
+     * 
+     * 入力はブロック単位で1度だけ走査し、各ブロックの区切り文字のビットマスクから
+     * コンポーネントの境界を求めて path_ へ直接コピーする (部分文字列は生成しない)。
+     */
+    void append_components(const char* origin, std::size_t pos, std::size_t size, Platform platform)
+    {
+        std::size_t start = pos;
+        for (std::size_t block = pos; block < size; block += SEPARATOR_BLOCK)
+        {
+            uint32_t mask = separator_mask(origin + block, std::min<std::size_t>(+SEPARATOR_BLOCK, size - block), platform);
+            while (mask != 0)
+            {
+                const std::size_t find_pos = block + lowest_bit(mask);
+                mask &= mask - 1;
+                if (find_pos != start)
+                    append_component(origin + start, find_pos - start);
+                start = find_pos + 1;
+            }
+        }
+        if (start < size)
+            append_component(origin + start, size - start);
+    }
+
+    /**
+     * @brief pos 以降の最初のコンポーネントの長さを length へ格納する (path_ は正規化済みのため区切り文字は連続しない)
+     * 
+     * @return bool pos が末尾に達している場合は false
+     */
+    bool next_component(std::size_t pos, std::size_t& length) const
+    {
+        if (pos >= path_.size())
+            return false;
+        std::size_t last = path_.find(separator(), pos);
+        if (last == std::string::npos)
+            last = path_.size();
+        length = last - pos;
+        return true;
+    }
+
+    std::size_t filename_position() const
+    {
+        const std::size_t pos = path_.find_last_of(separator());
+        return (pos == std::string::npos || pos + 1 < root_length()) ? root_length() : pos + 1;
+    }
+
+    bool is_dot(std::size_t pos, std::size_t length) const
+    {
+        return length == 1 && path_[pos] == '.';
+    }
+
+    bool is_dot_dot(std::size_t pos, std::size_t length) const
+    {
+        return length == 2 && path_[pos] == '.' && path_[pos + 1] == '.';
+    }
+
+    void pop_component()
+    {
+        std::size_t pos = path_.find_last_of(separator());
+        if (pos == std::string::npos || pos < root_length())
+            pos = root_length();
+        path_.erase(pos);
+        rehash();
+    }
+
+    void set(const std::string& path_str, Platform platform = NATIVE)
+    {
+        set(path_str.data(), path_str.size(), platform);
+    }
+
+    void set(const char* data, std::size_t size, Platform platform = NATIVE)
+    {
+        FILE_PATH_TRACE_GROWTH(path_);
+        platform_ = platform;
+        path_.clear();
+        path_.reserve(size + 1);
+
+        std::size_t pos = 0;
+        if (platform == WINDOWS)
+        {
+            is_absolute_ = has_drive(data, size);
+            if (is_absolute_)
+            {
+                path_.append(data, 2);
+                path_ += '\\';
+                pos = 3;
+            }
+        }
+        else
+        {
+            is_absolute_ = size > 0 && data[0] == '/';
+            if (is_absolute_)
+                path_ += '/';
+        }
+        rehash();
+        append_components(data, pos, size, platform);
+    }
+
+    void set(const std::wstring &wstring, const Platform platform = NATIVE) 
+    {
+#ifdef __unix__
+
+#else
+        std::string string;
+        append_narrow(string, wstring.data(), wstring.size());
+        set(string, platform);
+#endif
+    }
+
+};
+
+namespace std
+{
+    template<>
+    struct hash<FilePath>
+    {
+        std::size_t operator()(const FilePath& path) const
+        {
+            return path.hash();
+        }
+    };
+}
+
+/**
+ * @class FilePathView
+ * @brief パス文字列を借用し、ヒープ確保なしで解析する軽量なビュー (C++11 で使える string_view 相当)
+ *
+ * filename() / stem() / extension() / parent_path() やコンポーネントの列挙は元の文字列を指す
+ * FilePathView を返すため、文字列のコピーは発生しない。参照先の文字列はビューより長く生存していなければならない。
+ * FilePath と同じ規則で区切り文字とルートを解釈するが、重複する区切り文字は正規化せずそのまま扱う。
+ * 所有する FilePath が必要になった時点で to_path() で変換する。
+ */
+class FilePathView
+{
+public:
+    class const_iterator;
+
+    FilePathView()
+     :  data_(""), size_(0), platform_(FilePath::NATIVE)
+    {}
+
+    FilePathView(const char* str)
+     :  data_(str), size_(std::strlen(str)), platform_(FilePath::NATIVE)
+    {}
+
+    FilePathView(const char* str, std::size_t size, FilePath::Platform platform = FilePath::NATIVE)
+     :  data_(str), size_(size), platform_(platform)
+    {}
+
+    FilePathView(const std::string& str, FilePath::Platform platform = FilePath::NATIVE)
+     :  data_(str.data()), size_(str.size()), platform_(platform)
+    {}
+
+    const char* data() const
+    {
+        return data_;
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    FilePath::Platform platform() const
+    {
+        return platform_;
+    }
+
+    /**
+     * @brief ルート以外のコンポーネントを持たないか否か (FilePath::empty() と同じ判定)
+     */
+    bool empty() const;
+
+    bool is_absolute() const
+    {
+        return root_length() > 0;
+    }
+
+    const_iterator begin() const;
+
+    const_iterator end() const;
+
+    /**
+     * @brief 最後のコンポーネント (末尾の区切り文字は無視する)
+     */
+    FilePathView filename() const
+    {
+        const std::size_t last = trim_end(size_);
+        std::size_t first = last;
+        while (first > root_length() && !is_separator(data_[first - 1]))
+            --first;
+        return FilePathView(data_ + first, last - first, platform_);
+    }
+
+    /**
+     * @brief filename() から拡張子を除いた部分
+     */
+    FilePathView stem() const
+    {
+        const FilePathView name = filename();
+        const std::size_t pos = name.find_extension();
+        return (pos == npos) ? name : FilePathView(name.data_, pos, platform_);
+    }
+
+    /**
+     * @brief 拡張子 (FilePath::extension() と同じく '.' を含まない)
+     */
+    FilePathView extension() const
+    {
+        const FilePathView name = filename();
+        const std::size_t pos = name.find_extension();
+        if (pos == npos)
+            return FilePathView(name.data_ + name.size_, 0, platform_);
+        return FilePathView(name.data_ + pos + 1, name.size_ - pos - 1, platform_);
+    }
+
+    /**
+     * @brief 最後のコンポーネントを取り除いた部分 (文字列上の操作のみで、"." や ".." は解決しない)
+     */
+    FilePathView parent_path() const
+    {
+        const FilePathView name = filename();
+        return FilePathView(data_, trim_end(static_cast<std::size_t>(name.data_ - data_)), platform_);
+    }
+
+    /**
+     * @brief コンポーネント単位で prefix から始まるか否か ("/data/ab" は "/data/a" から始まらない)
+     */
+    bool starts_with(const FilePathView& prefix) const;
+
+    std::string to_str() const
+    {
+        return std::string(data_, size_);
+    }
+
+    /**
+     * @brief 所有する FilePath へ変換する (ここで初めてヒープ確保が発生する)
+     */
+    FilePath to_path() const
+    {
+        return FilePath(*this);
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const FilePathView& view)
+    {
+        os.write(view.data_, static_cast<std::streamsize>(view.size_));
+        return os;
+    }
+
+private:
+    static const std::size_t npos = static_cast<std::size_t>(-1);
+
+    const char* data_;
+    std::size_t size_;
+    FilePath::Platform platform_;
+
+    bool is_separator(char c) const
+    {
+        return c == '/' || (platform_ == FilePath::WINDOWS && c == '\\');
+    }
+
+    std::size_t root_length() const
+    {
+        if (platform_ == FilePath::WINDOWS)
+            return FilePath::has_drive(data_, size_) ? 3 : 0;
+        return (size_ > 0 && data_[0] == '/') ? 1 : 0;
+    }
+
+    std::size_t trim_end(std::size_t last) const
+    {
+        const std::size_t root = root_length();
+        while (last > root && is_separator(data_[last - 1]))
+            --last;
+        return last;
+    }
+
+    /**
+     * @brief 自身をファイル名とみなした場合の拡張子の '.' の位置 ("." と ".." は拡張子を持たない)
+     */
+    std::size_t find_extension() const
+    {
+        if ((size_ == 1 && data_[0] == '.') || (size_ == 2 && data_[0] == '.' && data_[1] == '.'))
+            return npos;
+        for (std::size_t pos = size_; pos > 0; --pos)
+        {
+            if (data_[pos - 1] == '.')
+                return pos - 1;
+        }
+        return npos;
+    }
+
+    static bool equals(const char* lhs, std::size_t lhs_size, const char* rhs, std::size_t rhs_size)
+    {
+        return lhs_size == rhs_size && std::memcmp(lhs, rhs, lhs_size) == 0;
+    }
+};
+
+/**
+ * @class FilePathView::const_iterator
+ * @brief ルートを除くコンポーネントを先頭から順に FilePathView として返す前方イテレータ
+ */
+class FilePathView::const_iterator
+{
+public:
+    typedef std::forward_iterator_tag   iterator_category;
+    typedef FilePathView                value_type;
+    typedef std::ptrdiff_t              difference_type;
+    typedef const FilePathView*         pointer;
+    typedef const FilePathView&         reference;
+
+    const_iterator()
+     :  owner_(NULL), pos_(0), current_()
+    {}
+
+    reference operator*() const
+    {
+        return current_;
+    }
+
+    pointer operator->() const
+    {
+        return &current_;
+    }
+
+    const_iterator& operator++()
+    {
+        seek(pos_ + current_.size_);
+        return *this;
+    }
+
+    const_iterator operator++(int)
+    {
+        const_iterator result(*this);
+        ++*this;
+        return result;
+    }
+
+    bool operator==(const const_iterator& other) const
+    {
+        return pos_ == other.pos_;
+    }
+
+    bool operator!=(const const_iterator& other) const
+    {
+        return pos_ != other.pos_;
+    }
+
+private:
+    friend class FilePathView;
+
+    const FilePathView* owner_;
+    std::size_t pos_;
+    FilePathView current_;
+
+    const_iterator(const FilePathView* owner, std::size_t pos)
+     :  owner_(owner), pos_(pos), current_()
+    {
+        seek(pos);
+    }
+
+    void seek(std::size_t pos)
+    {
+        const FilePathView& owner = *owner_;
+        while (pos < owner.size_ && owner.is_separator(owner.data_[pos]))
+            ++pos;
+        pos_ = pos;
+        const std::size_t last = FilePath::find_separator(owner.data_, pos, owner.size_, owner.platform_);
+        current_ = FilePathView(owner.data_ + pos, last - pos, owner.platform_);
+    }
+};
+
+inline bool FilePathView::empty() const
+{
+    return begin() == end();
+}
+
+inline FilePathView::const_iterator FilePathView::begin() const
+{
+    return const_iterator(this, root_length());
+}
+
+inline FilePathView::const_iterator FilePathView::end() const
+{
+    return const_iterator(this, size_);
+}
+
+inline bool FilePathView::starts_with(const FilePathView& prefix) const
+{
+    if (root_length() != prefix.root_length())
+        return false;
+    if (!equals(data_, root_length(), prefix.data_, prefix.root_length()))
+        return false;
+
+    const_iterator it = begin();
+    const const_iterator last = end();
+    for (const_iterator p = prefix.begin(), p_last = prefix.end(); p != p_last; ++p, ++it)
+    {
+        if (it == last || !equals(it->data_, it->size_, p->data_, p->size_))
+            return false;
+    }
+    return true;
+}
+
+inline FilePath::FilePath(const FilePathView& view)
+ :  path_(), hash_(HASH_BASIS), is_absolute_(false), platform_(view.platform())
+{
+    set(view.data(), view.size(), view.platform());
+}
+
+inline FilePathView FilePath::view() const
+{
+    return FilePathView(path_, platform_);
+}
+
+/**
+ * @brief StaticFilePath の構築に用いる 0, 1, ..., N-1 の整数列 (C++11 には std::index_sequence がないため自前で用意する)
+ */
+template<std::size_t... I>
+struct StaticPathIndices
+{
+    typedef StaticPathIndices type;
+};
+
+template<class Lhs, class Rhs>
+struct ConcatStaticPathIndices;
+
+template<std::size_t... Lhs, std::size_t... Rhs>
+struct ConcatStaticPathIndices<StaticPathIndices<Lhs...>, StaticPathIndices<Rhs...> >
+ :  StaticPathIndices<Lhs..., (sizeof...(Lhs) + Rhs)...>
+{};
+
+/**
+ * @brief 半分ずつ生成して連結するため、テンプレートの再帰は log2(N) 段で済む
+ */
+template<std::size_t N>
+struct MakeStaticPathIndices
+ :  ConcatStaticPathIndices<typename MakeStaticPathIndices<N / 2>::type, typename MakeStaticPathIndices<N - N / 2>::type>::type
+{};
+
+template<>
+struct MakeStaticPathIndices<0> : StaticPathIndices<>
+{};
+
+template<>
+struct MakeStaticPathIndices<1> : StaticPathIndices<0>
+{};
+
+/**
+ * @class StaticFilePath
+ * @brief ビルド時に決まるパスをコンパイル時に正規化・検証して保持する固定長のパス
+ * 
+ * 文字列リテラルから constexpr で構築でき、FilePath::set() と同じ規則 (重複・末尾の区切り文字の除去、
+ * プラットフォームの区切り文字への統一) で正規化した結果を char[N] に格納する。ヒープは使わない。
+ * プラットフォームはテンプレート引数のため、区切り文字の判定や to_str() の分岐はコンパイル時に畳み込まれる。
+ * 不正なパス (途中の NUL 、Windows で使えない文字) は、コンパイル時の構築ではコンパイルエラー、
+ * 実行時の構築では std::invalid_argument となる。
+ * 
+ * 正規化は constexpr 関数の再帰で行うため、コンパイラの constexpr の再帰上限 (GCC / Clang の既定は 512 程度) を超える長さには使えない。
+ * 
+ * @code
+ * constexpr StaticFilePath<sizeof("/etc//app/")> config("/etc//app/");     // "/etc/app"
+ * static_assert(config.component_count() == 2, "");
+ * FilePath path = config / FilePath("app.conf");
+ * @endcode
+ * 
+ * @tparam N 元の文字列リテラルの長さ (終端の NUL を含む)
+ * @tparam P パスの形式
+ */
+template<std::size_t N, FilePath::Platform P = FilePath::NATIVE>
+class StaticFilePath
+{
+public:
+    static const std::size_t CAPACITY = N;
+
+    /**
+     * @param str 文字列リテラル (終端の NUL を含めて N 文字)
+     */
+    constexpr StaticFilePath(const char (&str)[N])
+     :  StaticFilePath(str, typename MakeStaticPathIndices<N>::type())
+    {}
+
+    static constexpr FilePath::Platform platform()
+    {
+        return P;
+    }
+
+    /**
+     * @brief 正規化後の文字数 (終端の NUL を含まない)
+     */
+    constexpr std::size_t size() const
+    {
+        return size_;
+    }
+
+    constexpr const char* c_str() const
+    {
+        return data_;
+    }
+
+    constexpr const char* data() const
+    {
+        return data_;
+    }
+
+    constexpr bool is_absolute() const
+    {
+        return root_length_ > 0;
+    }
+
+    /**
+     * @brief ルート以外のコンポーネントを持たないか否か
+     */
+    constexpr bool empty() const
+    {
+        return size_ == root_length_;
+    }
+
+    /**
+     * @brief ルートを除くコンポーネントの数
+     */
+    constexpr std::size_t component_count() const
+    {
+        return empty() ? 0 : 1 + count_separators(root_length_);
+    }
+
+    FilePathView view() const
+    {
+        return FilePathView(data_, size_, P);
+    }
+
+    /**
+     * @brief FilePath へ変換する (正規化済みの文字列をコピーしてハッシュ値を計算するだけで、再解析はしない)
+     */
+    FilePath to_path() const
+    {
+        FilePath result;
+        result.platform_ = P;
+        result.is_absolute_ = is_absolute();
+        result.path_.assign(data_, size_);
+        result.rehash();
+        return result;
+    }
+
+    operator FilePath() const
+    {
+        return to_path();
+    }
+
+    /**
+     * @brief P の形式の文字列 (変換なし)
+     */
+    std::string to_str() const
+    {
+        return std::string(data_, size_);
+    }
+
+    std::string to_str(FilePath::Platform platform) const
+    {
+        if (platform == P)
+            return to_str();
+        return to_path().to_str(platform);
+    }
+
+    FilePath operator/(const FilePath& other) const
+    {
+        return to_path() / other;
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const StaticFilePath& path)
+    {
+        os.write(path.data_, static_cast<std::streamsize>(path.size_));
+        return os;
+    }
+
+private:
+    static const std::size_t LENGTH = N - 1;      /**< 元の文字列の長さ (終端の NUL を含まない) */
+
+    char data_[N];
+    std::size_t size_;
+    std::size_t root_length_;
+
+    template<std::size_t... I>
+    constexpr StaticFilePath(const char (&str)[N], StaticPathIndices<I...>)
+     :  data_{ output_char(str, I)... },
+        size_(is_valid(str, 0) ? kept_count(str, 0) : throw std::invalid_argument("StaticFilePath: invalid path literal")),
+        root_length_(root_length(str))
+    {}
+
+    static constexpr char separator()
+    {
+        return (P == FilePath::UNIX) ? '/' : '\\';
+    }
+
+    static constexpr bool is_separator(char c)
+    {
+        return c == '/' || (P == FilePath::WINDOWS && c == '\\');
+    }
+
+    static constexpr bool has_drive(const char* str)
+    {
+        return LENGTH >= 3 && ((str[0] >= 'A' && str[0] <= 'Z') || (str[0] >= 'a' && str[0] <= 'z')) && str[1] == ':' && (str[2] == '/' || str[2] == '\\');
+    }
+
+    static constexpr std::size_t root_length(const char* str)
+    {
+        return (P == FilePath::WINDOWS) ? (has_drive(str) ? 3 : 0) : ((LENGTH > 0 && str[0] == '/') ? 1 : 0);
+    }
+
+    /**
+     * @brief 終端以外に NUL を含まず、Windows ではコンポーネントに使えない文字を含まないか否か
+     */
+    static constexpr bool is_valid(const char* str, std::size_t pos)
+    {
+        return pos >= LENGTH ? str[LENGTH] == '\0'
+             : (str[pos] != '\0'
+                && (P != FilePath::WINDOWS || pos < root_length(str)
+                    || (str[pos] != '<' && str[pos] != '>' && str[pos] != ':' && str[pos] != '"' && str[pos] != '|' && str[pos] != '?' && str[pos] != '*'))
+                && is_valid(str, pos + 1));
+    }
+
+    /**
+     * @brief pos 以降に区切り文字以外の文字があるか否か
+     */
+    static constexpr bool has_name_after(const char* str, std::size_t pos)
+    {
+        return pos < LENGTH && (!is_separator(str[pos]) || has_name_after(str, pos + 1));
+    }
+
+    /**
+     * @brief 元の文字列の pos 番目を正規化後も残すか否か
+     * 
+     * ルートとコンポーネントの文字は残し、区切り文字はコンポーネントの直後にあり、かつ後ろに別のコンポーネントが続く場合のみ残す。
+     */
+    static constexpr bool is_kept(const char* str, std::size_t pos)
+    {
+        return pos < root_length(str) || !is_separator(str[pos])
+            || (pos > root_length(str) && !is_separator(str[pos - 1]) && has_name_after(str, pos + 1));
+    }
+
+    static constexpr std::size_t kept_count(const char* str, std::size_t pos)
+    {
+        return pos >= LENGTH ? 0 : (is_kept(str, pos) ? 1 : 0) + kept_count(str, pos + 1);
+    }
+
+    /**
+     * @brief 正規化後の index 番目の文字が元の文字列の何番目か
+     */
+    static constexpr std::size_t kept_position(const char* str, std::size_t index, std::size_t pos)
+    {
+        return is_kept(str, pos) ? (index == 0 ? pos : kept_position(str, index - 1, pos + 1)) : kept_position(str, index, pos + 1);
+    }
+
+    static constexpr char converted_char(const char* str, std::size_t pos)
+    {
+        return (P == FilePath::WINDOWS && pos == 2 && root_length(str) == 3) ? '\\'
+             : (pos >= root_length(str) && is_separator(str[pos])) ? separator() : str[pos];
+    }
+
+    static constexpr char output_char(const char* str, std::size_t index)
+    {
+        return index < kept_count(str, 0) ? converted_char(str, kept_position(str, index, 0)) : '\0';
+    }
+
+    constexpr std::size_t count_separators(std::size_t pos) const
+    {
+        return pos >= size_ ? 0 : (data_[pos] == separator() ? 1 : 0) + count_separators(pos + 1);
+    }
+};
+
+template<std::size_t N, FilePath::Platform P>
+const std::size_t StaticFilePath<N, P>::CAPACITY;
+
+template<std::size_t N, FilePath::Platform P>
+const std::size_t StaticFilePath<N, P>::LENGTH;
+
+/**
+ * @brief 文字列リテラルから StaticFilePath を構築する (N を書かずに済ませるための関数)
+ * 
+ * @code
+ * constexpr auto config = make_static_path("/etc/app");
+ * @endcode
+ */
+template<std::size_t N>
+constexpr StaticFilePath<N> make_static_path(const char (&str)[N])
+{
+    return StaticFilePath<N>(str);
+}
+
+#if defined(__GNUC__) && __cplusplus >= 201402L && !defined(FILE_PATH_DISABLE_PATH_LITERAL)
+/**
+ * @brief ユーザー定義リテラル "..."_path の文字を保持する配列
+ */
+template<char... C>
+struct StaticPathChars
+{
+    static constexpr char value[sizeof...(C) + 1] = { C..., '\0' };
+};
+
+template<char... C>
+constexpr char StaticPathChars<C...>::value[sizeof...(C) + 1];
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wgnu-string-literal-operator-template"
+#endif
+/**
+ * @brief "/etc/app"_path でネイティブ形式の StaticFilePath をコンパイル時に構築する
+ * 
+ * 文字列リテラル演算子テンプレートは GCC / Clang の C++14 以降の拡張のため、それ以外の環境では make_static_path() を用いる。
+ */
+template<class Char, Char... C>
+constexpr StaticFilePath<sizeof...(C) + 1> operator"" _path()
+{
+    static_assert(std::is_same<Char, char>::value, "_path expects a narrow string literal");
+    return StaticFilePath<sizeof...(C) + 1>(StaticPathChars<C...>::value);
+}
+#pragma GCC diagnostic pop
+#endif
+
+/**
+ * @class MonotonicArena
+ * @brief 確保のたびにポインタを進めるだけの単調増加アロケータ (個別の解放は行わず、release() で一括解放する)
+ *
+ * 1回の走査で得られる多数の短い文字列や配列をまとめて置いておき、結果が不要になった時点で
+ * ブロック単位で一度に解放するために用いる。スレッドセーフではないため、
+ * DirectoryWalker の訪問関数などから並列に使う場合はワーカーごとに用意すること。
+ */
+class MonotonicArena
+{
+public:
+    explicit MonotonicArena(std::size_t block_size = 64 * 1024)
+     :  head_(NULL), current_(NULL), end_(NULL), block_size_(block_size), allocated_(0)
+    {}
+
+    ~MonotonicArena()
+    {
+        release();
+    }
+
+    /**
+     * @brief size バイトを alignment 境界で確保する (現在のブロックに収まらなければ新しいブロックを確保する)
+     * 
+     * @param size 確保するバイト数
+     * @param alignment 2 の冪であること
+     * @return void* 
+     */
+    void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t))
+    {
+        char* first = align(current_, alignment);
+        if (current_ == NULL || first > end_ || static_cast<std::size_t>(end_ - first) < size)
+        {
+            add_block(size + alignment);
+            first = align(current_, alignment);
+        }
+        current_ = first + size;
+        allocated_ += size;
+        return first;
+    }
+
+    /**
+     * @brief data[0, size) を NUL 終端付きでアリーナへ複製する
+     * 
+     * @return const char* 
+     */
+    const char* copy(const char* data, std::size_t size)
+    {
+        char* result = static_cast<char*>(allocate(size + 1, 1));
+        std::memcpy(result, data, size);
+        result[size] = '\0';
+        return result;
+    }
+
+    /**
+     * @brief パス文字列をアリーナへ複製し、それを指す FilePathView を返す
+     */
+    FilePathView copy(const FilePathView& path)
+    {
+        return FilePathView(copy(path.data(), path.size()), path.size(), path.platform());
+    }
+
+    /**
+     * @brief 確保した全てのブロックを解放する (このアリーナから得たポインタは全て無効になる)
+     */
+    void release()
+    {
+        while (head_ != NULL)
+        {
+            Block* next = head_->next;
+            ::operator delete(head_);
+            head_ = next;
+        }
+        current_ = end_ = NULL;
+        allocated_ = 0;
+    }
+
+    /**
+     * @brief 利用者へ払い出したバイト数の合計
+     */
+    std::size_t bytes_allocated() const
+    {
+        return allocated_;
+    }
+
+private:
+    struct Block
+    {
+        Block* next;
+    };
+
+    Block* head_;
+    char* current_;
+    char* end_;
+    std::size_t block_size_;
+    std::size_t allocated_;
+
+    static char* align(char* pos, std::size_t alignment)
+    {
+        const uintptr_t value = reinterpret_cast<uintptr_t>(pos);
+        return reinterpret_cast<char*>((value + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+    }
+
+    void add_block(std::size_t minimum)
+    {
+        const std::size_t size = std::max(block_size_, minimum) + sizeof(Block);
+        Block* block = static_cast<Block*>(::operator new(size));
+        block->next = head_;
+        head_ = block;
+        current_ = reinterpret_cast<char*>(block) + sizeof(Block);
+        end_ = reinterpret_cast<char*>(block) + size;
+    }
+
+    MonotonicArena(const MonotonicArena&);
+    MonotonicArena& operator=(const MonotonicArena&);
+};
+
+/**
+ * @class ArenaAllocator
+ * @brief MonotonicArena から確保する標準コンテナ用のアロケータ (deallocate() は何もしない)
+ */
+template<class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(MonotonicArena& arena)
+     :  arena_(&arena)
+    {}
+
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U>& other)
+     :  arena_(other.arena_)
+    {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, std::size_t)
+    {}
+
+    MonotonicArena& arena() const
+    {
+        return *arena_;
+    }
+
+    template<class U>
+    bool operator==(const ArenaAllocator<U>& other) const
+    {
+        return arena_ == other.arena_;
+    }
+
+    template<class U>
+    bool operator!=(const ArenaAllocator<U>& other) const
+    {
+        return arena_ != other.arena_;
+    }
+
+private:
+    template<class U> friend class ArenaAllocator;
+
+    MonotonicArena* arena_;
+};
+
+/**
+ * @class PathTable
+ * @brief 大量のパスをコンポーネント単位で共有して保持するインターンテーブル
+ *
+ * 各コンポーネント名は一意な文字列として1度だけ連結バッファへ格納し (コンポーネント ID)、パスは
+ * (親ノード, コンポーネント ID) の組からなるトライのノードとして表す。intern() は 32bit のハンドルを返し、
+ * 必要になった時点で path() により FilePath へ展開する。ノード1個あたりの消費量は
+ * ノード 8 バイト + ハッシュテーブル 4〜8 バイトで、"/data/tenant/2026/10/..." のように長い共通の
+ * プレフィックスを持つパスの集合では FilePath をそのまま保持する場合より大幅に小さくなる。
+ * ハンドルは削除されず、テーブルが生存する限り有効である。スレッドセーフではない。
+ */
+class PathTable
+{
+public:
+    typedef uint32_t Handle;
+
+    static const Handle INVALID = 0xFFFFFFFFu;
+
+    explicit PathTable(FilePath::Platform platform = FilePath::NATIVE)
+     :  platform_(platform), names_(), name_offsets_(1, 0), nodes_(), name_slots_(), node_slots_()
+    {
+        // 相対パスの起点 (空のルート) をノード 0 とする
+        insert_node(INVALID, insert_name("", 0));
+    }
+
+    /**
+     * @brief パスを登録し、そのハンドルを返す (登録済みであれば同じハンドルを返す)
+     * 
+     * @param path 登録するパス (テーブルと同じ Platform であること)
+     * @return Handle 
+     */
+    Handle intern(const FilePath& path)
+    {
+        if (path.platform_ != platform_)
+            throw std::runtime_error("PathTable::intern(): expected a path of the same type!");
+
+        Handle node = insert_node(INVALID, insert_name(path.path_.data(), path.root_length()));
+        std::size_t length;
+        for (std::size_t pos = path.root_length(); path.next_component(pos, length); pos += length + 1)
+            node = insert_node(node, insert_name(path.path_.data() + pos, length));
+        return node;
+    }
+
+    /**
+     * @brief parent の直下のコンポーネント name を登録し、そのハンドルを返す
+     * 
+     * @param parent 親のハンドル
+     * @param name 区切り文字を含まないコンポーネント名
+     * @return Handle 
+     */
+    Handle intern(Handle parent, const std::string& name)
+    {
+        return insert_node(parent, insert_name(name.data(), name.size()));
+    }
+
+    /**
+     * @brief 登録済みのパスのハンドルを探す (新たな登録は行わない)
+     * 
+     * @return Handle 見つからない場合は INVALID
+     */
+    Handle find(const FilePath& path) const
+    {
+        if (path.platform_ != platform_)
+            return INVALID;
+
+        std::size_t slot;
+        uint32_t name = find_name(path.path_.data(), path.root_length(), slot);
+        Handle node = (name == INVALID) ? INVALID : find_node(INVALID, name, slot);
+        std::size_t length;
+        for (std::size_t pos = path.root_length(); node != INVALID && path.next_component(pos, length); pos += length + 1)
+        {
+            name = find_name(path.path_.data() + pos, length, slot);
+            node = (name == INVALID) ? INVALID : find_node(node, name, slot);
+        }
+        return node;
+    }
+
+    /**
+     * @brief 親のハンドル (ルートの場合は INVALID)
+     */
+    Handle parent(Handle handle) const
+    {
+        return nodes_[handle].parent;
+    }
+
+    /**
+     * @brief 最後のコンポーネント名 (ルートの場合は "/" や "C:\\" 、相対パスの起点の場合は空)。テーブル内の文字列を指す
+     */
+    FilePathView name(Handle handle) const
+    {
+        const uint32_t id = nodes_[handle].name;
+        return FilePathView(names_.data() + name_offsets_[id], name_offsets_[id + 1] - name_offsets_[id], platform_);
+    }
+
+    /**
+     * @brief ハンドルを FilePath へ展開する (長さを求めてから末尾側から書き込むため、確保は1回)
+     * 
+     * @param handle intern() が返したハンドル
+     * @return FilePath 
+     */
+    FilePath path(Handle handle) const
+    {
+        std::size_t length = 0;
+        std::size_t components = 0;
+        Handle root = handle;
+        for (Handle node = handle; node != INVALID; node = nodes_[node].parent)
+        {
+            length += name_length(nodes_[node].name);
+            if (nodes_[node].parent != INVALID)
+                ++components;
+            root = node;
+        }
+        if (components > 1)
+            length += components - 1;
+
+        FilePath result;
+        result.platform_    = platform_;
+        result.is_absolute_ = name_length(nodes_[root].name) > 0;
+        result.path_.resize(length);
+
+        const char separator = result.separator();
+        std::size_t last = length;
+        for (Handle node = handle; node != INVALID; node = nodes_[node].parent)
+        {
+            const uint32_t id = nodes_[node].name;
+            last -= name_length(id);
+            std::memcpy(&result.path_[last], names_.data() + name_offsets_[id], name_length(id));
+            if (last > 0 && nodes_[node].parent != INVALID && nodes_[node].parent != root)
+                result.path_[--last] = separator;
+        }
+        result.rehash();
+        return result;
+    }
+
+    /**
+     * @brief 登録済みのノード数 (ルートを含む)
+     */
+    std::size_t size() const
+    {
+        return nodes_.size();
+    }
+
+    /**
+     * @brief 一意なコンポーネント名の数
+     */
+    std::size_t unique_names() const
+    {
+        return name_offsets_.size() - 1;
+    }
+
+    /**
+     * @brief テーブルが確保しているおおよそのバイト数
+     */
+    std::size_t memory_usage() const
+    {
+        return sizeof(*this) + names_.capacity()
+            + name_offsets_.capacity() * sizeof(uint32_t)
+            + nodes_.capacity() * sizeof(Node)
+            + (name_slots_.capacity() + node_slots_.capacity()) * sizeof(uint32_t);
+    }
+
+    FilePath::Platform platform() const
+    {
+        return platform_;
+    }
+
+private:
+    struct Node
+    {
+        Handle parent;
+        uint32_t name;
+    };
+
+    FilePath::Platform platform_;
+    std::string names_;                     /**< 一意なコンポーネント名を連結したバッファ */
+    std::vector<uint32_t> name_offsets_;    /**< ID i の名前は names_[name_offsets_[i], name_offsets_[i + 1]) */
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> name_slots_;      /**< 名前のオープンアドレス法テーブル (ID + 1 、0 は空き) */
+    std::vector<uint32_t> node_slots_;      /**< (親, 名前) のオープンアドレス法テーブル (ハンドル + 1 、0 は空き) */
+
+    std::size_t name_length(uint32_t id) const
+    {
+        return name_offsets_[id + 1] - name_offsets_[id];
+    }
+
+    static std::size_t name_hash(const char* data, std::size_t length)
+    {
+        return static_cast<std::size_t>(FilePath::hash_bytes(data, length, FilePath::HASH_BASIS));
+    }
+
+    static std::size_t node_hash(Handle parent, uint32_t name)
+    {
+        uint64_t key = (static_cast<uint64_t>(parent) << 32) | name;
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return static_cast<std::size_t>(key);
+    }
+
+    uint32_t find_name(const char* data, std::size_t length, std::size_t& slot) const
+    {
+        const std::size_t mask = name_slots_.size() - 1;
+        for (slot = name_hash(data, length) & mask; name_slots_[slot] != 0; slot = (slot + 1) & mask)
+        {
+            const uint32_t id = name_slots_[slot] - 1;
+            if (name_length(id) == length && std::memcmp(names_.data() + name_offsets_[id], data, length) == 0)
+                return id;
+        }
+        return INVALID;
+    }
+
+    Handle find_node(Handle parent, uint32_t name, std::size_t& slot) const
+    {
+        const std::size_t mask = node_slots_.size() - 1;
+        for (slot = node_hash(parent, name) & mask; node_slots_[slot] != 0; slot = (slot + 1) & mask)
+        {
+            const Node& node = nodes_[node_slots_[slot] - 1];
+            if (node.parent == parent && node.name == name)
+                return node_slots_[slot] - 1;
+        }
+        return INVALID;
+    }
+
+    uint32_t insert_name(const char* data, std::size_t length)
+    {
+        if ((unique_names() + 1) * 2 > name_slots_.size())
+            grow_names();
+
+        std::size_t slot;
+        const uint32_t found = find_name(data, length, slot);
+        if (found != INVALID)
+            return found;
+        if (names_.size() + length > 0xFFFFFFFFu)
+            throw std::runtime_error("PathTable::intern(): too many components!");
+
+        const uint32_t id = static_cast<uint32_t>(unique_names());
+        names_.append(data, length);
+        name_offsets_.push_back(static_cast<uint32_t>(names_.size()));
+        name_slots_[slot] = id + 1;
+        return id;
+    }
+
+    Handle insert_node(Handle parent, uint32_t name)
+    {
+        if ((nodes_.size() + 1) * 2 > node_slots_.size())
+            grow_nodes();
+
+        std::size_t slot;
+        const Handle found = find_node(parent, name, slot);
+        if (found != INVALID)
+            return found;
+        if (nodes_.size() >= INVALID - 1)
+            throw std::runtime_error("PathTable::intern(): too many paths!");
+
+        const Handle handle = static_cast<Handle>(nodes_.size());
+        Node node;
+        node.parent = parent;
+        node.name   = name;
+        nodes_.push_back(node);
+        node_slots_[slot] = handle + 1;
+        return handle;
+    }
+
+    void grow_names()
+    {
+        std::vector<uint32_t> slots(std::max<std::size_t>(16, name_slots_.size() * 2), 0);
+        const std::size_t mask = slots.size() - 1;
+        for (uint32_t id = 0; id < unique_names(); ++id)
+        {
+            std::size_t slot = name_hash(names_.data() + name_offsets_[id], name_length(id)) & mask;
+            while (slots[slot] != 0)
+                slot = (slot + 1) & mask;
+            slots[slot] = id + 1;
+        }
+        name_slots_.swap(slots);
+    }
+
+    void grow_nodes()
+    {
+        std::vector<uint32_t> slots(std::max<std::size_t>(16, node_slots_.size() * 2), 0);
+        const std::size_t mask = slots.size() - 1;
+        for (Handle handle = 0; handle < nodes_.size(); ++handle)
+        {
+            std::size_t slot = node_hash(nodes_[handle].parent, nodes_[handle].name) & mask;
+            while (slots[slot] != 0)
+                slot = (slot + 1) & mask;
+            slots[slot] = handle + 1;
+        }
+        node_slots_.swap(slots);
+    }
+
+    PathTable(const PathTable&);
+    PathTable& operator=(const PathTable&);
+};
+
+/**
+ * @class MappedFile
+ * @brief ファイル全体を読み取り専用でメモリへマップし、コピーなしで内容を参照する RAII クラス
+ * 
+ * POSIX では mmap / madvise 、Windows では CreateFileMapping / MapViewOfFile を用いる。
+ * サイズはマップに用いるハンドルから取得するか、呼び出し側が既に持つ FileStatus を再利用する。
+ * マップ中にファイルが切り詰められた場合、末尾を超えた領域への参照は SIGBUS 等となる。
+ */
+class MappedFile
+{
+public:
+    /**
+     * @brief アクセスパターンのヒント (madvise の MADV_* に対応する)
+     */
+    enum Advice
+    {
+        NORMAL = 0,
+        SEQUENTIAL,
+        RANDOM,
+        WILLNEED,
+        DONTNEED
+    };
+
+    typedef const char* const_iterator;
+
+    MappedFile()
+     :  data_(NULL), size_(0), status_(), open_(false)
+#ifndef __unix__
+        , file_(INVALID_HANDLE_VALUE), mapping_(NULL)
+#endif
+    {}
+
+    /**
+     * @brief path をマップする (失敗した場合は is_open() が false となる)
+     * 
+     * @param path 対象のファイル
+     * @param advice マップ直後に与えるアクセスパターンのヒント
+     * @param huge_pages 可能であれば透過的ヒュージページを用いる (Linux の MADV_HUGEPAGE 。Windows では無視する)
+     */
+    explicit MappedFile(const FilePath& path, Advice advice = NORMAL, bool huge_pages = false)
+     :  data_(NULL), size_(0), status_(), open_(false)
+#ifndef __unix__
+        , file_(INVALID_HANDLE_VALUE), mapping_(NULL)
+#endif
+    {
+        open(path, NULL, advice, huge_pages);
+    }
+
+    /**
+     * @brief 取得済みの status のサイズを用いて path をマップする (fstat を省略する)
+     * 
+     * @param path 対象のファイル
+     * @param status path の属性 (通常のファイルでない場合は失敗する)
+     * @param advice マップ直後に与えるアクセスパターンのヒント
+     * @param huge_pages 可能であれば透過的ヒュージページを用いる
+     */
+    MappedFile(const FilePath& path, const FileStatus& status, Advice advice = NORMAL, bool huge_pages = false)
+     :  data_(NULL), size_(0), status_(), open_(false)
+#ifndef __unix__
+        , file_(INVALID_HANDLE_VALUE), mapping_(NULL)
+#endif
+    {
+        open(path, &status, advice, huge_pages);
+    }
+
+    MappedFile(MappedFile&& other)
+     :  data_(other.data_), size_(other.size_), status_(other.status_), open_(other.open_)
+#ifndef __unix__
+        , file_(other.file_), mapping_(other.mapping_)
+#endif
+    {
+        other.release();
+    }
+
+    MappedFile& operator=(MappedFile&& other)
+    {
+        if (this != &other)
+        {
+            close();
+            data_   = other.data_;
+            size_   = other.size_;
+            status_ = other.status_;
+            open_   = other.open_;
+#ifndef __unix__
+            file_    = other.file_;
+            mapping_ = other.mapping_;
+#endif
+            other.release();
+        }
+        return *this;
+    }
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    bool is_open() const
+    {
+        return open_;
+    }
+
+    const char* data() const
+    {
+        return data_;
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    const_iterator begin() const
+    {
+        return data_;
+    }
+
+    const_iterator end() const
+    {
+        return data_ + size_;
+    }
+
+    char operator[](std::size_t pos) const
+    {
+        return data_[pos];
+    }
+
+    /**
+     * @brief マップに用いたファイルの属性
+     */
+    const FileStatus& status() const
+    {
+        return status_;
+    }
+
+    /**
+     * @brief [offset, offset + length) へアクセスパターンのヒントを与える
+     * 
+     * @param advice 
+     * @param offset 
+     * @param length 末尾までの場合は省略する
+     * @return bool ヒントを適用できた場合は true (Windows では WILLNEED 以外は何もせず false)
+     */
+    bool advise(Advice advice, std::size_t offset = 0, std::size_t length = static_cast<std::size_t>(-1))
+    {
+        if (data_ == NULL || offset >= size_)
+            return false;
+        length = std::min(length, size_ - offset);
+#ifdef __unix__
+        // madvise はページ境界から始まる範囲を要求する
+        const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        const std::size_t first = offset - offset % page;
+        return madvise(const_cast<char*>(data_) + first, length + (offset - first), to_madvise(advice)) == 0;
+#else
+        if (advice != WILLNEED)
+            return false;
+        return prefetch(offset, length);
+#endif
+    }
+
+    /**
+     * @brief [offset, offset + length) を先読みする
+     */
+    bool prefetch(std::size_t offset = 0, std::size_t length = static_cast<std::size_t>(-1))
+    {
+#ifdef __unix__
+        return advise(WILLNEED, offset, length);
+#else
+        if (data_ == NULL || offset >= size_)
+            return false;
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+        WIN32_MEMORY_RANGE_ENTRY range;
+        range.VirtualAddress = const_cast<char*>(data_) + offset;
+        range.NumberOfBytes  = std::min(length, size_ - offset);
+        return PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0) != 0;
+#else
+        (void)length;
+        return false;
+#endif
+#endif
+    }
+
+    void close()
+    {
+#ifdef __unix__
+        if (data_ != NULL && size_ > 0)
+            munmap(const_cast<char*>(data_), size_);
+#else
+        if (data_ != NULL && size_ > 0)
+            UnmapViewOfFile(data_);
+        if (mapping_ != NULL)
+            CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE)
+            CloseHandle(file_);
+#endif
+        release();
+    }
+
+private:
+    const char* data_;
+    std::size_t size_;
+    FileStatus status_;
+    bool open_;
+#ifndef __unix__
+    HANDLE file_;
+    HANDLE mapping_;
+#endif
+
+    void release()
+    {
+        data_   = NULL;
+        size_   = 0;
+        status_ = FileStatus();
+        open_   = false;
+#ifndef __unix__
+        file_    = INVALID_HANDLE_VALUE;
+        mapping_ = NULL;
+#endif
+    }
+
+#ifdef __unix__
+    static int to_madvise(Advice advice)
+    {
+        switch (advice)
+        {
+        case SEQUENTIAL: return MADV_SEQUENTIAL;
+        case RANDOM:     return MADV_RANDOM;
+        case WILLNEED:   return MADV_WILLNEED;
+        case DONTNEED:   return MADV_DONTNEED;
+        default:         return MADV_NORMAL;
+        }
+    }
+#endif
+
+    void open(const FilePath& path, const FileStatus* known, Advice advice, bool huge_pages)
+    {
+        FILE_PATH_TRACE(OPEN_FILE);
+#ifdef __unix__
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return;
+        if (known != NULL)
+        {
+            status_ = *known;
+        }
+        else
+        {
+            FILE_PATH_COUNT(STAT);
+            struct stat st;
+            status_ = (fstat(fd, &st) == 0) ? FileStatus(st) : FileStatus::from_errno(errno);
+        }
+        if (!status_.is_file())
+        {
+            ::close(fd);
+            status_ = FileStatus();
+            return;
+        }
+
+        size_ = static_cast<std::size_t>(status_.size());
+        if (size_ == 0)
+        {
+            // 長さ 0 の mmap は失敗するため、空のファイルはマップせずに開いた扱いとする
+            ::close(fd);
+            data_ = "";
+            open_ = true;
+            return;
+        }
+
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        if (advice == WILLNEED)
+            flags |= MAP_POPULATE;
+#endif
+        void* address = mmap(NULL, size_, PROT_READ, flags, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED)
+        {
+            release();
+            return;
+        }
+        data_ = static_cast<const char*>(address);
+        open_ = true;
+
+#ifdef MADV_HUGEPAGE
+        if (huge_pages)
+            madvise(address, size_, MADV_HUGEPAGE);
+#else
+        (void)huge_pages;
+#endif
+        if (advice != NORMAL)
+            madvise(address, size_, to_madvise(advice));
+#else
+        (void)huge_pages;
+        const DWORD hint = (advice == SEQUENTIAL) ? FILE_FLAG_SEQUENTIAL_SCAN : (advice == RANDOM) ? FILE_FLAG_RANDOM_ACCESS : 0;
+        file_ = CreateFileW(path.win32_path().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | hint, NULL);
+        if (file_ == INVALID_HANDLE_VALUE)
+            return;
+        if (known != NULL)
+        {
+            status_ = *known;
+        }
+        else
+        {
+            BY_HANDLE_FILE_INFORMATION info;
+            if (GetFileInformationByHandle(file_, &info))
+                status_ = FileStatus(info.dwFileAttributes, info.ftLastWriteTime, info.nFileSizeHigh, info.nFileSizeLow, true);
+        }
+        if (!status_.is_file())
+        {
+            close();
+            return;
+        }
+
+        size_ = static_cast<std::size_t>(status_.size());
+        open_ = true;
+        if (size_ == 0)
+        {
+            data_ = "";
+            return;
+        }
+
+        mapping_ = CreateFileMappingW(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping_ == NULL)
+        {
+            close();
+            return;
+        }
+        data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, size_));
+        if (data_ == NULL)
+        {
+            size_ = 0;
+            close();
+            return;
+        }
+        if (advice == WILLNEED)
+            prefetch();
+#endif
+    }
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+inline MappedFile FilePath::map_readonly(bool huge_pages) const
+{
+    return MappedFile(*this, MappedFile::NORMAL, huge_pages);
+}
+
+inline MappedFile FilePath::map_readonly(const FileStatus& status, bool huge_pages) const
+{
+    return MappedFile(*this, status, MappedFile::NORMAL, huge_pages);
+}
+
+/**
+ * @class DirectoryHandle
+ * @brief 開いたディレクトリを保持し、その配下のエントリをディレクトリ相対で操作するハンドル
+ * 
+ * POSIX ではディレクトリの fd を保持し、fstatat / openat / unlinkat / mkdirat を用いるため、
+ * 深い階層でもカーネルが親ディレクトリのパスを毎回解決し直すことはない。
+ * Windows には相当する API がないため、保持したパスと連結して通常の操作を行う。
+ * 各操作は std::error_code の多重定義を持たず、失敗の詳細は errno (Windows では GetLastError) に残る。
+ */
+class DirectoryHandle
+{
+public:
+    DirectoryHandle()
+     :  path_(),
+#ifdef __unix__
+        fd_(-1)
+#else
+        open_(false)
+#endif
+    {}
+
+    explicit DirectoryHandle(const FilePath& path)
+     :  path_(path),
+#ifdef __unix__
+        fd_(-1)
+#else
+        open_(path.is_directory())
+#endif
+    {
+#ifdef __unix__
+        FILE_PATH_TRACE(OPEN_DIRECTORY);
+        fd_ = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#endif
+    }
+
+    DirectoryHandle(DirectoryHandle&& other)
+     :  path_(std::move(other.path_)),
+#ifdef __unix__
+        fd_(other.fd_)
+#else
+        open_(other.open_)
+#endif
+    {
+#ifdef __unix__
+        other.fd_ = -1;
+#else
+        other.open_ = false;
+#endif
+    }
+
+    DirectoryHandle& operator=(DirectoryHandle&& other)
+    {
+        if (this != &other)
+        {
+            close();
+            path_ = std::move(other.path_);
+#ifdef __unix__
+            fd_ = other.fd_;
+            other.fd_ = -1;
+#else
+            open_ = other.open_;
+            other.open_ = false;
+#endif
+        }
+        return *this;
+    }
+
+    ~DirectoryHandle()
+    {
+        close();
+    }
+
+    bool is_open() const
+    {
+#ifdef __unix__
+        return fd_ >= 0;
+#else
+        return open_;
+#endif
+    }
+
+    const FilePath& path() const
+    {
+        return path_;
+    }
+
+#ifdef __unix__
+    /**
+     * @brief 保持しているディレクトリの fd
+     */
+    int fd() const
+    {
+        return fd_;
+    }
+#endif
+
+    void close()
+    {
+#ifdef __unix__
+        if (fd_ >= 0)
+            ::close(fd_);
+        fd_ = -1;
+#else
+        open_ = false;
+#endif
+    }
+
+    /**
+     * @brief ディレクトリ自身の属性を取得する
+     */
+    FileStatus status() const
+    {
+#ifdef __unix__
+        FILE_PATH_TRACE(STAT);
+        struct stat st;
+        if (fstat(fd_, &st) != 0)
+            return FileStatus::from_errno(errno);
+        return FileStatus(st);
+#else
+        return path_.status();
+#endif
+    }
+
+    /**
+     * @brief 配下のエントリの属性を取得する (シンボリックリンクを辿る)
+     * 
+     * @param name ディレクトリからの相対パス
+     */
+    FileStatus status(const char* name) const
+    {
+#ifdef __unix__
+        return stat_at(name, 0);
+#else
+        return child(name).status();
+#endif
+    }
+
+    /**
+     * @brief 配下のエントリ自身の属性を取得する (シンボリックリンクを辿らない)
+     * 
+     * @param name ディレクトリからの相対パス
+     */
+    FileStatus symlink_status(const char* name) const
+    {
+#ifdef __unix__
+        return stat_at(name, AT_SYMLINK_NOFOLLOW);
+#else
+        return child(name).symlink_status();
+#endif
+    }
+
+    /**
+     * @brief 配下のディレクトリを開く
+     * 
+     * @param name ディレクトリからの相対パス
+     * @return DirectoryHandle 開けなかった場合は is_open() が false となる
+     */
+    DirectoryHandle open_directory(const char* name) const
+    {
+        DirectoryHandle result;
+        result.path_ = child(name);
+#ifdef __unix__
+        FILE_PATH_TRACE(OPEN_DIRECTORY);
+        result.fd_ = openat(fd_, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#else
+        result.open_ = result.path_.is_directory();
+#endif
+        return result;
+    }
+
+#ifdef __unix__
+    /**
+     * @brief 配下のファイルを openat で開く
+     * 
+     * @param name ディレクトリからの相対パス
+     * @param flags open(2) のフラグ (O_CLOEXEC は常に付与される)
+     * @param mode ファイルを作成する場合のパーミッション
+     * @return int ファイルディスクリプタ (失敗時は -1)
+     */
+    int open(const char* name, int flags, mode_t mode = 0644) const
+    {
+        FILE_PATH_TRACE(OPEN_FILE);
+        return openat(fd_, name, flags | O_CLOEXEC, mode);
+    }
+#else
+    /**
+     * @brief 配下のファイルを CreateFileW で開く
+     * 
+     * @return HANDLE 失敗時は INVALID_HANDLE_VALUE
+     */
+    HANDLE open(const char* name, DWORD access, DWORD creation) const
+    {
+        FILE_PATH_TRACE(OPEN_FILE);
+        return CreateFileW(child(name).win32_path().c_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, creation, FILE_ATTRIBUTE_NORMAL, NULL);
+    }
+#endif
+
+    bool remove_file(const char* name) const
+    {
+        FILE_PATH_TRACE(REMOVE);
+#ifdef __unix__
+        return unlinkat(fd_, name, 0) == 0;
+#else
+        return DeleteFileW(child(name).win32_path().c_str()) != 0;
+#endif
+    }
+
+    bool remove_directory(const char* name) const
+    {
+        FILE_PATH_TRACE(REMOVE);
+#ifdef __unix__
+        return unlinkat(fd_, name, AT_REMOVEDIR) == 0;
+#else
+        return RemoveDirectoryW(child(name).win32_path().c_str()) != 0;
+#endif
+    }
+
+    bool create_directory(const char* name) const
+    {
+        FILE_PATH_TRACE(CREATE_DIRECTORY);
+#ifdef __unix__
+        return mkdirat(fd_, name, S_IRWXU) == 0;
+#else
+        return CreateDirectoryW(child(name).win32_path().c_str(), NULL) != 0;
+#endif
+    }
+
+private:
+    friend class DirectoryIterator;
+
+    FilePath path_;
+#ifdef __unix__
+    int fd_;
+#else
+    bool open_;
+#endif
+
+    DirectoryHandle(const DirectoryHandle&);
+    DirectoryHandle& operator=(const DirectoryHandle&);
+
+    FilePath child(const char* name) const
+    {
+        FilePath result(path_);
+        result.append_component(name, std::strlen(name));
+        return result;
+    }
+
+#ifdef __unix__
+    FileStatus stat_at(const char* name, int flags) const
+    {
+        FILE_PATH_TRACE(STAT);
+        struct stat st;
+        if (fstatat(fd_, name, &st, flags) != 0)
+            return FileStatus::from_errno(errno);
+        return FileStatus(st);
+    }
+#endif
+};
+
+/**
+ * @class DirectoryEntry
+ * @brief DirectoryIterator が返すエントリ。パスと合わせてカーネルが返したメタデータを保持する
+ * 
+ * POSIX では readdir の d_type / d_ino を、Windows では WIN32_FIND_DATA の属性・サイズ・更新時刻を
+ * 保持するため、種別の判定 (および Windows ではサイズの取得) に追加のシステムコールを必要としない。
+ * シンボリックリンクを辿る判定や、d_type から得られない属性が必要な場合に限り stat を行う。
+ */
+class DirectoryEntry
+{
+public:
+    DirectoryEntry()
+     :  path_(), symlink_status_(), complete_(false)
+    {}
+
+    const FilePath& path() const
+    {
+        return path_;
+    }
+
+    operator const FilePath&() const
+    {
+        return path_;
+    }
+
+    std::string filename() const
+    {
+        return path_.filename();
+    }
+
+    /**
+     * @brief シンボリックリンクを辿らないエントリ自身の種別を取得する (システムコールなし)
+     * 
+     * @return FileStatus::Type 
+     */
+    FileStatus::Type type() const
+    {
+        return symlink_status_.type();
+    }
+
+    /** @brief inode 番号 (Windows では 0) */
+    uint64_t inode() const
+    {
+        return symlink_status_.inode();
+    }
+
+    bool is_symlink() const
+    {
+        return type() == FileStatus::SYMLINK;
+    }
+
+    /**
+     * @brief ディレクトリか否か (シンボリックリンクの場合のみ stat でリンク先を確認する)
+     */
+    bool is_directory() const
+    {
+        return is_symlink() ? path_.is_directory() : type() == FileStatus::DIRECTORY;
+    }
+
+    /**
+     * @brief 通常ファイルか否か (シンボリックリンクの場合のみ stat でリンク先を確認する)
+     */
+    bool is_file() const
+    {
+        return is_symlink() ? path_.is_file() : type() == FileStatus::REGULAR;
+    }
+
+    /**
+     * @brief ファイルサイズを取得する (Windows ではシステムコールなし)
+     * 
+     * @return int64_t 通常ファイルでない場合は -1
+     */
+    int64_t file_size() const
+    {
+        return FilePath::file_size(status());
+    }
+
+    /**
+     * @brief シンボリックリンクを辿った先の属性を取得する
+     * 
+     * 保持しているメタデータで足りる場合はシステムコールを行わない。
+     */
+    FileStatus status() const
+    {
+        if (complete_ && !is_symlink())
+            return symlink_status_;
+        return path_.status();
+    }
+
+    /**
+     * @brief エントリ自身の属性を取得する
+     * 
+     * 保持しているメタデータで足りる場合はシステムコールを行わない。
+     */
+    FileStatus symlink_status() const
+    {
+        if (complete_)
+            return symlink_status_;
+        return path_.symlink_status();
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const DirectoryEntry& entry)
+    {
+        os << entry.path_;
+        return os;
+    }
+
+private:
+    friend class DirectoryIterator;
+
+    FilePath path_;
+    FileStatus symlink_status_;         /**< 種別と inode は常に有効。その他は complete_ の場合のみ有効 */
+    bool complete_;                     /**< symlink_status_ の全フィールドが有効 */
+};
+
+/**
+ * @class DirectoryIterator
+ * @brief opendir / readdir (Windows では FindFirstFile / FindNextFile) を逐次呼び出す入力イテレータ
+ * 
+ * 各エントリは DirectoryEntry として返され、パスに加えて readdir / FindNextFile が返した
+ * メタデータを保持する。エントリは1件ずつ読み出されるため、巨大なディレクトリでも最初のエントリを即座に取得でき、
+ * 途中で走査を打ち切った場合は残りを読み込まない。"." と ".." は返さない。
+ * コピーしたイテレータは読み出し位置を共有する。
+ * 
+ * @code
+ * for (const DirectoryEntry& entry : DirectoryIterator("/var/spool"))
+ * {
+ *     if (entry.is_file())
+ *         std::cout << entry.path() << std::endl;
+ * }
+ * @endcode
+ */
+class DirectoryIterator
+{
+public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef DirectoryEntry          value_type;
+    typedef std::ptrdiff_t          difference_type;
+    typedef const DirectoryEntry*   pointer;
+    typedef const DirectoryEntry&   reference;
+
+    /**
+     * @brief 終端イテレータを生成する
+     */
+    DirectoryIterator()
+    {}
+
+    /**
+     * @brief 対象ディレクトリを開き、最初のエントリを読み出す
+     * 
+     * @param path 対象ディレクトリ (開けない場合は終端イテレータとなる)
+     */
+    explicit DirectoryIterator(const FilePath& path)
+     :  state_(new State(path))
+    {
+        if (!state_->open())
+            state_.reset();
+        else
+            increment();
+    }
+
+    /**
+     * @brief 対象ディレクトリを開き、最初のエントリを読み出す (開けない場合は ec へエラーを格納して終端イテレータとなる)
+     */
+    DirectoryIterator(const FilePath& path, std::error_code& ec)
+     :  state_(new State(path))
+    {
+        if (!state_->open())
+        {
+            ec = FilePath::last_error_code();
+            state_.reset();
+        }
+        else
+        {
+            ec.clear();
+            increment();
+        }
+    }
+
+    /**
+     * @brief 開いているディレクトリのエントリを先頭から読み出す (パスの再解決を行わない)
+     * 
+     * @param directory 対象ディレクトリ (開いていない場合は終端イテレータとなる)
+     */
+    explicit DirectoryIterator(const DirectoryHandle& directory)
+     :  state_(new State(directory.path()))
+    {
+        if (!state_->open(directory))
+            state_.reset();
+        else
+            increment();
+    }
+
+    /**
+     * @brief ディレクトリのハンドルを引き取ってエントリを読み出す (fd を開き直さない)
+     * 
+     * @param directory 対象ディレクトリ (呼び出し後は閉じた状態となる)
+     */
+    explicit DirectoryIterator(DirectoryHandle&& directory)
+     :  state_(new State(directory.path()))
+    {
+        if (!state_->adopt(directory))
+            state_.reset();
+        else
+            increment();
+    }
+
+    reference operator*() const
+    {
+        return state_->entry;
+    }
+
+    pointer operator->() const
+    {
+        return &state_->entry;
+    }
+
+    DirectoryIterator& operator++()
+    {
+        increment();
+        return *this;
+    }
+
+    bool operator==(const DirectoryIterator& other) const
+    {
+        return state_ == other.state_;
+    }
+
+    bool operator!=(const DirectoryIterator& other) const
+    {
+        return state_ != other.state_;
+    }
+
+private:
+    struct State
+    {
+        DirectoryEntry entry;           /**< 現在のエントリ (パスのバッファを使い回す) */
+        std::size_t prefix_length;      /**< entry のうちディレクトリ部分の長さ */
+        uint64_t prefix_hash;           /**< ディレクトリ部分のハッシュ値 (エントリ名の分だけ続きを計算する) */
+#ifdef __unix__
+        DIR* dir;
+        struct dirent* current;
+#else
+        HANDLE handle;
+        WIN32_FIND_DATAW data;
+        bool pending;                   /**< FindFirstFile で読み出した未処理のエントリがある */
+        std::wstring pattern;           /**< FindFirstFileW に渡す "ディレクトリ\\*" */
+        std::string name;               /**< data.cFileName を UTF-8 へ変換したもの */
+        std::size_t prefix_native_length;   /**< entry.native_ のうちディレクトリ部分の長さ */
+#endif
+
+        explicit State(const FilePath& path)
+         :  entry(), prefix_length(0), prefix_hash(0),
+#ifdef __unix__
+            dir(NULL), current(NULL)
+#else
+            handle(INVALID_HANDLE_VALUE), pending(false), pattern(), name(), prefix_native_length(0)
+#endif
+        {
+            FilePath& base = entry.path_;
+            base = path;
+            if (!base.empty())
+                base.path_ += base.separator();
+            base.rehash();
+            prefix_length = base.path_.size();
+            prefix_hash = base.hash_;
+#ifndef __unix__
+            prefix_native_length = base.native_.size();
+            pattern = path.win32_path().c_str();
+            if (!pattern.empty() && pattern[pattern.size() - 1] != L'\\' && pattern[pattern.size() - 1] != L'/')
+                pattern += L'\\';
+            pattern += L'*';
+#endif
+        }
+
+        ~State()
+        {
+#ifdef __unix__
+            if (dir != NULL)
+                closedir(dir);
+#else
+            if (handle != INVALID_HANDLE_VALUE)
+                FindClose(handle);
+#endif
+        }
+
+        bool open()
+        {
+            FilePath& base = entry.path_;
+            FILE_PATH_TRACE(OPEN_DIRECTORY);
+#ifdef __unix__
+            dir = opendir(base.c_str());
+            return dir != NULL;
+#else
+            (void)base;
+            handle = FindFirstFileW(pattern.c_str(), &data);
+            pending = (handle != INVALID_HANDLE_VALUE);
+            return pending;
+#endif
+        }
+
+        bool open(const DirectoryHandle& directory)
+        {
+            if (!directory.is_open())
+                return false;
+#ifdef __unix__
+            FILE_PATH_TRACE(OPEN_DIRECTORY);
+            // 同じ fd を共有すると読み出し位置も共有されるため、"." を開き直す
+            const int fd = openat(directory.fd(), ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd < 0)
+                return false;
+            dir = fdopendir(fd);
+            if (dir == NULL)
+            {
+                ::close(fd);
+                return false;
+            }
+            return true;
+#else
+            return open();
+#endif
+        }
+
+        bool adopt(DirectoryHandle& directory)
+        {
+            if (!directory.is_open())
+                return false;
+#ifdef __unix__
+            dir = fdopendir(directory.fd_);
+            if (dir == NULL)
+                return false;
+            directory.fd_ = -1;
+            return true;
+#else
+            directory.open_ = false;
+            return open();
+#endif
+        }
+
+        const char* read()
+        {
+            FILE_PATH_COUNT(READ_DIRECTORY);
+#ifdef __unix__
+            current = readdir(dir);
+            return (current != NULL) ? current->d_name : NULL;
+#else
+            if (!pending && !FindNextFileW(handle, &data))
+                return NULL;
+            pending = false;
+            name.clear();
+            FilePath::append_narrow(name, data.cFileName, wcslen(data.cFileName));
+            return name.c_str();
+#endif
+        }
+
+        /**
+         * @brief 読み出したエントリのメタデータを entry へ反映する
+         */
+        void fill_status()
+        {
+#ifdef __unix__
+            FileStatus::Type type = FileStatus::UNKNOWN;
+#ifdef _DIRENT_HAVE_D_TYPE
+            switch (current->d_type)
+            {
+            case DT_REG:  type = FileStatus::REGULAR;   break;
+            case DT_DIR:  type = FileStatus::DIRECTORY; break;
+            case DT_LNK:  type = FileStatus::SYMLINK;   break;
+            case DT_BLK:  type = FileStatus::BLOCK;     break;
+            case DT_CHR:  type = FileStatus::CHARACTER; break;
+            case DT_FIFO: type = FileStatus::FIFO;      break;
+            case DT_SOCK: type = FileStatus::SOCKET;    break;
+            default:                                    break;
+            }
+#endif
+            if (type == FileStatus::UNKNOWN)
+            {
+                // d_type を返さないファイルシステムでは開いているディレクトリからの fstatat で補う
+                FILE_PATH_TRACE(STAT);
+                struct stat st;
+                if (fstatat(dirfd(dir), current->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0)
+                    entry.symlink_status_ = FileStatus(st);
+                else
+                    entry.symlink_status_ = FileStatus::from_errno(errno);
+                entry.complete_ = true;
+            }
+            else
+            {
+                entry.symlink_status_ = FileStatus(type, static_cast<uint64_t>(current->d_ino));
+                entry.complete_ = false;
+            }
+#else
+            const bool is_symlink = (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0 && data.dwReserved0 == IO_REPARSE_TAG_SYMLINK;
+            const DWORD attributes = is_symlink ? data.dwFileAttributes : (data.dwFileAttributes & ~FILE_ATTRIBUTE_REPARSE_POINT);
+            entry.symlink_status_ = FileStatus(attributes, data.ftLastWriteTime, data.nFileSizeHigh, data.nFileSizeLow, false);
+            entry.complete_ = true;
+#endif
+        }
+
+    private:
+        State(const State&);
+        State& operator=(const State&);
+    };
+
+    friend class RecursiveDirectoryIterator;
+
+    std::shared_ptr<State> state_;
+
+    /**
+     * @brief 現在のエントリを読み出し中のディレクトリからの相対で開く
+     */
+    DirectoryHandle open_current() const
+    {
+        DirectoryHandle result;
+        result.path_ = state_->entry.path_;
+#ifdef __unix__
+        FILE_PATH_TRACE(OPEN_DIRECTORY);
+        result.fd_ = openat(dirfd(state_->dir), state_->current->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#else
+        result.open_ = true;        // 開けなければ FindFirstFileW が失敗する
+#endif
+        return result;
+    }
+
+    void increment()
+    {
+        const char* name;
+        while ((name = state_->read()) != NULL)
+        {
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                continue;
+            FilePath& path = state_->entry.path_;
+            path.path_.erase(state_->prefix_length);
+            path.path_.append(name);
+#ifdef __unix__
+            path.hash_ = state_->prefix_hash;
+            path.extend_hash(state_->prefix_length);
+#else
+            // UTF-16 の名前は FindNextFileW が返したものをそのまま使い、変換し直さない
+            path.hash_ = FilePath::hash_bytes(path.path_.data() + state_->prefix_length, path.path_.size() - state_->prefix_length, state_->prefix_hash);
+            path.native_.resize(state_->prefix_native_length);
+            path.native_ += state_->data.cFileName;
+#endif
+            state_->fill_status();
+            return;
+        }
+        state_.reset();
+    }
+};
+
+inline DirectoryIterator begin(DirectoryIterator it)
+{
+    return it;
+}
+
+inline DirectoryIterator end(const DirectoryIterator&)
+{
+    return DirectoryIterator();
+}
+
+inline std::vector<FilePath> FilePath::directory_iterator(const FilePath& path)
+{
+    std::vector<FilePath> result;
+    for (DirectoryIterator it((DirectoryHandle(path))), last; it != last; ++it)
+        result.push_back(it->path());
+    return result;
+}
+
+inline std::vector<FilePath> FilePath::directory_iterator(const FilePath& path, std::error_code& ec)
+{
+    std::vector<FilePath> result;
+    DirectoryHandle handle(path);
+    if (!report(handle.is_open(), ec))
+        return result;
+    for (DirectoryIterator it(std::move(handle)), last; it != last; ++it)
+        result.push_back(it->path());
+    return result;
+}
+
+inline std::vector<FilePathView, ArenaAllocator<FilePathView> > FilePath::directory_iterator(const FilePath& path, MonotonicArena& arena)
+{
+    std::vector<FilePathView, ArenaAllocator<FilePathView> > result((ArenaAllocator<FilePathView>(arena)));
+    for (DirectoryIterator it((DirectoryHandle(path))), last; it != last; ++it)
+        result.push_back(arena.copy(it->path().view()));
+    return result;
+}
+
+/**
+ * @class RecursiveDirectoryIterator
+ * @brief DirectoryIterator を積み重ねてサブディレクトリを深さ優先で辿る入力イテレータ (単一スレッド)
+ * 
+ * WalkOptions::max_depth / follow_symlinks に従って降りるか否かを決め、
+ * disable_recursion_pending() で現在のディレクトリ配下を刈り込むことができる。
+ * follow_symlinks 時は、現在のディレクトリの祖先へ戻るリンクにのみ降りない
+ * (循環しない複数のリンクから同じディレクトリへ到達した場合は、それぞれ列挙する) 。
+ */
+class RecursiveDirectoryIterator
+{
+public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef DirectoryEntry          value_type;
+    typedef std::ptrdiff_t          difference_type;
+    typedef const DirectoryEntry*   pointer;
+    typedef const DirectoryEntry&   reference;
+
+    /**
+     * @brief 終端イテレータを生成する
+     */
+    RecursiveDirectoryIterator()
+    {}
+
+    explicit RecursiveDirectoryIterator(const FilePath& path, const WalkOptions& options = WalkOptions())
+     :  state_(new State(options))
+    {
+        DirectoryIterator it((DirectoryHandle(path)));
+        if (it == DirectoryIterator())
+        {
+            state_.reset();
+            return;
+        }
+        state_->push(it, options.follow_symlinks ? path.status() : FileStatus());
+    }
+
+    reference operator*() const
+    {
+        return *state_->stack.back();
+    }
+
+    pointer operator->() const
+    {
+        return &*state_->stack.back();
+    }
+
+    RecursiveDirectoryIterator& operator++()
+    {
+        increment();
+        return *this;
+    }
+
+    bool operator==(const RecursiveDirectoryIterator& other) const
+    {
+        return state_ == other.state_;
+    }
+
+    bool operator!=(const RecursiveDirectoryIterator& other) const
+    {
+        return state_ != other.state_;
+    }
+
+    /**
+     * @brief 現在のエントリの深さ (開始ディレクトリ直下が 0)
+     */
+    int depth() const
+    {
+        return static_cast<int>(state_->stack.size()) - 1;
+    }
+
+    /**
+     * @brief 次のインクリメントで現在のエントリ (ディレクトリ) へ降りないようにする
+     */
+    void disable_recursion_pending()
+    {
+        state_->recursion_pending = false;
+    }
+
+    /**
+     * @brief 現在のディレクトリの残りを読み飛ばし、親ディレクトリの次のエントリへ進む
+     */
+    void pop()
+    {
+        state_->pop();
+        state_->recursion_pending = true;
+        if (!state_->stack.empty())
+            ++state_->stack.back();
+        settle();
+    }
+
+private:
+    struct State
+    {
+        WalkOptions options;
+        std::vector<DirectoryIterator> stack;
+        bool recursion_pending;
+        std::vector<std::pair<uint64_t, uint64_t> > ancestors; /**< stack の各階層のディレクトリの (device, inode) 。follow_symlinks 時の循環検出に用いる */
+
+        explicit State(const WalkOptions& options)
+         :  options(options), stack(), recursion_pending(true), ancestors()
+        {}
+
+        void push(const DirectoryIterator& it, const FileStatus& st)
+        {
+            stack.push_back(it);
+            ancestors.push_back(std::make_pair(st.device(), st.inode()));
+        }
+
+        void pop()
+        {
+            stack.pop_back();
+            ancestors.pop_back();
+        }
+
+        /**
+         * @brief st が現在のディレクトリかその祖先か否か (inode を持たない Windows では常に false)
+         */
+        bool is_ancestor(const FileStatus& st) const
+        {
+            if (st.inode() == 0)
+                return false;
+            return std::find(ancestors.begin(), ancestors.end(), std::make_pair(st.device(), st.inode())) != ancestors.end();
+        }
+    };
+
+    std::shared_ptr<State> state_;
+
+    void increment()
+    {
+        State& state = *state_;
+        const DirectoryEntry& entry = *state.stack.back();
+        bool descend = state.recursion_pending
+            && (state.options.max_depth < 0 || depth() < state.options.max_depth)
+            && (state.options.follow_symlinks ? entry.is_directory() : entry.type() == FileStatus::DIRECTORY);
+        FileStatus st;
+        if (descend && state.options.follow_symlinks)
+        {
+            st = entry.status();
+            descend = !state.is_ancestor(st);      // 祖先へのリンクで循環する場合は降りない
+        }
+        state.recursion_pending = true;
+
+        if (descend)
+        {
+            // 親の DIR からの openat で開き、その fd をそのまま読み出しに使う
+            DirectoryIterator child(state.stack.back().open_current());
+            if (child != DirectoryIterator())
+            {
+                state.push(child, st);
+                return;
+            }
+        }
+        ++state.stack.back();
+        settle();
+    }
+
+    void settle()
+    {
+        State& state = *state_;
+        const DirectoryIterator last;
+        while (!state.stack.empty() && state.stack.back() == last)
+        {
+            state.pop();
+            if (!state.stack.empty())
+                ++state.stack.back();
+        }
+        if (state.stack.empty())
+            state_.reset();
+    }
+};
+
+inline RecursiveDirectoryIterator begin(RecursiveDirectoryIterator it)
+{
+    return it;
+}
+
+inline RecursiveDirectoryIterator end(const RecursiveDirectoryIterator&)
+{
+    return RecursiveDirectoryIterator();
+}
+
+/**
+ * @class WorkStealingPool
+ * @brief ワーカーごとのタスクキューを持ち、空いたワーカーが他のキューから盗んで実行するスレッドプール
+ * 
+ * 各ワーカーは自身のキューを LIFO で、他のワーカーのキューを FIFO で取り出す。
+ * タスクの中から spawn() したタスクも含め、全てのタスクが完了すると run() が戻る。
+ * タスクが例外を送出した場合は残りのタスクを破棄し、run() が最初の例外を再送出する。
+ */
+class WorkStealingPool
+{
+public:
+    typedef std::function<void(std::size_t worker)> Task;
+
+    /**
+     * @param threads ワーカー数 (0 の場合はコア数, run() を呼び出したスレッドを含む)
+     */
+    explicit WorkStealingPool(unsigned threads = 0)
+     :  queues_(threads == 0 ? default_concurrency() : threads), pending_(0), queued_(0), sleepers_(0), aborted_(false)
+    {}
+
+    std::size_t size() const
+    {
+        return queues_.size();
+    }
+
+    /**
+     * @brief タスクを worker のキューへ積む (タスク内からは自身の worker 番号を渡す)
+     */
+    void spawn(std::size_t worker, const Task& task)
+    {
+        Queue& queue = queues_[worker % queues_.size()];
+        pending_.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(task);
+        }
+        queued_.fetch_add(1);
+        wake(false);
+    }
+
+    /**
+     * @brief 全てのタスクが完了するまで、呼び出し元スレッドを含むワーカーでタスクを実行する
+     */
+    void run()
+    {
+        std::vector<std::thread> threads;
+        for (std::size_t i = 1; i < queues_.size(); ++i)
+            threads.push_back(std::thread(&WorkStealingPool::work, this, i));
+        work(0);
+        for (std::size_t i = 0; i < threads.size(); ++i)
+            threads[i].join();
+
+        aborted_ = false;
+        if (error_)
+        {
+            std::exception_ptr error = error_;
+            error_ = std::exception_ptr();
+            std::rethrow_exception(error);
+        }
+    }
+
+    static unsigned default_concurrency()
+    {
+        const unsigned concurrency = std::thread::hardware_concurrency();
+        return (concurrency == 0) ? 1 : concurrency;
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<Queue> queues_;
+    std::atomic<std::size_t> pending_;      /**< 未完了のタスク数 (実行中を含む) */
+    std::atomic<std::size_t> queued_;       /**< キューに積まれているタスク数 */
+    std::atomic<std::size_t> sleepers_;
+    std::atomic<bool> aborted_;
+    std::mutex idle_mutex_;
+    std::condition_variable idle_cv_;
+    std::mutex error_mutex_;
+    std::exception_ptr error_;
+
+    WorkStealingPool(const WorkStealingPool&);
+    WorkStealingPool& operator=(const WorkStealingPool&);
+
+    bool pop(std::size_t worker, Task& task)
+    {
+        {
+            Queue& own = queues_[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                task = own.tasks.back();
+                own.tasks.pop_back();
+                queued_.fetch_sub(1);
+                return true;
+            }
+        }
+        for (std::size_t i = 1; i < queues_.size(); ++i)
+        {
+            Queue& victim = queues_[(worker + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                queued_.fetch_sub(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(std::size_t worker)
+    {
+        Task task;
+        for (;;)
+        {
+            if (pop(worker, task))
+            {
+                if (!aborted_)
+                {
+                    try
+                    {
+                        task(worker);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(error_mutex_);
+                        if (!error_)
+                            error_ = std::current_exception();
+                        aborted_ = true;
+                    }
+                }
+                task = Task();
+                if (pending_.fetch_sub(1) == 1)
+                    wake(true);
+                continue;
+            }
+
+            if (pending_.load() == 0)
+                return;
+
+            std::unique_lock<std::mutex> lock(idle_mutex_);
+            sleepers_.fetch_add(1);
+            while (queued_.load() == 0 && pending_.load() != 0)
+                idle_cv_.wait(lock);
+            sleepers_.fetch_sub(1);
+        }
+    }
+
+    void wake(bool all)
+    {
+        if (sleepers_.load() == 0)
+            return;
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        if (all)
+            idle_cv_.notify_all();
+        else
+            idle_cv_.notify_one();
+    }
+};
+
+/**
+ * @class AncestorChain
+ * @brief 並列に走査するタスク間で共有する、開始ディレクトリから現在のディレクトリまでの (device, inode) の連鎖
+ * 
+ * follow_symlinks 時の循環検出に用いる。祖先とのみ比較するため、
+ * 循環しない複数のリンクから同じディレクトリへ到達した場合はそれぞれ走査する。
+ */
+class AncestorChain
+{
+public:
+    typedef std::shared_ptr<const AncestorChain> Ptr;
+
+    /**
+     * @brief chain の末尾に st のディレクトリを加えた連鎖
+     */
+    static Ptr push(const Ptr& chain, const FileStatus& st)
+    {
+        return Ptr(new AncestorChain(chain, st));
+    }
+
+    /**
+     * @brief st が chain に含まれる (循環している) か否か (inode を持たない Windows では常に false)
+     */
+    static bool contains(const Ptr& chain, const FileStatus& st)
+    {
+        if (st.inode() == 0)
+            return false;
+        for (const AncestorChain* it = chain.get(); it != NULL; it = it->parent_.get())
+        {
+            if (it->device_ == st.device() && it->inode_ == st.inode())
+                return true;
+        }
+        return false;
+    }
+
+private:
+    Ptr parent_;
+    uint64_t device_;
+    uint64_t inode_;
+
+    AncestorChain(const Ptr& parent, const FileStatus& st)
+     :  parent_(parent), device_(st.device()), inode_(st.inode())
+    {}
+
+    AncestorChain(const AncestorChain&);
+    AncestorChain& operator=(const AncestorChain&);
+};
+
+/**
+ * @class DirectoryWalker
+ * @brief FilePath::walk の実装。ディレクトリ1つの読み出しを1タスクとして WorkStealingPool で並列に走査する
+ * 
+ * 各ディレクトリは DirectoryHandle で開き、子ディレクトリの open やエントリの stat は
+ * 親ディレクトリの fd からの相対で行う。
+ */
+class DirectoryWalker
+{
+public:
+    typedef std::function<bool(const DirectoryEntry& entry, int depth)> Visitor;
+
+    static void walk(const FilePath& root, const Visitor& visitor, const WalkOptions& options = WalkOptions())
+    {
+        DirectoryWalker walker(visitor, options);
+        walker.spawn_root(root);
+        walker.pool_.run();
+    }
+
+private:
+    const Visitor& visitor_;
+    const WalkOptions options_;
+    WorkStealingPool pool_;
+
+    DirectoryWalker(const Visitor& visitor, const WalkOptions& options)
+     :  visitor_(visitor), options_(options), pool_(options.threads)
+    {}
+
+    void spawn_root(const FilePath& root)
+    {
+        pool_.spawn(0, [this, root](std::size_t worker)
+        {
+            std::shared_ptr<DirectoryHandle> handle(new DirectoryHandle(root));
+            scan(worker, handle, 0, AncestorChain::Ptr());
+        });
+    }
+
+    /**
+     * 子ディレクトリは親のハンドルからの openat で開く。ハンドルは子のタスクが開き終えるまで共有され、
+     * 最後の子が開いた時点で閉じる (開いたまま待つ fd を積み上げない)。
+     */
+    void spawn(std::size_t worker, std::shared_ptr<DirectoryHandle> parent, const std::string& name, int depth, const AncestorChain::Ptr& ancestors)
+    {
+        pool_.spawn(worker, [this, parent, name, depth, ancestors](std::size_t current) mutable
+        {
+            std::shared_ptr<DirectoryHandle> handle(new DirectoryHandle(parent->open_directory(name.c_str())));
+            parent.reset();
+            if (!handle->is_open())
+                *handle = DirectoryHandle(handle->path());    // fd の枯渇時などはフルパスで再試行する
+            scan(current, handle, depth, ancestors);
+        });
+    }
+
+    /**
+     * @param ancestors follow_symlinks 時の handle の祖先 (それ以外では空のまま)
+     */
+    void scan(std::size_t worker, const std::shared_ptr<DirectoryHandle>& handle, int depth, AncestorChain::Ptr ancestors)
+    {
+        if (!handle->is_open())
+            return;
+        if (options_.follow_symlinks)
+        {
+            const FileStatus st = handle->status();
+            if (AncestorChain::contains(ancestors, st))
+                return;             // 祖先へのリンクで循環している
+            ancestors = AncestorChain::push(ancestors, st);
+        }
+
+        for (DirectoryIterator it(*handle), last; it != last; ++it)
+        {
+            const DirectoryEntry& entry = *it;
+            if (!visitor_(entry, depth))
+                continue;
+            if (options_.max_depth >= 0 && depth >= options_.max_depth)
+                continue;
+            const bool is_directory = options_.follow_symlinks ? entry.is_directory() : entry.type() == FileStatus::DIRECTORY;
+            if (is_directory)
+                spawn(worker, handle, entry.filename(), depth + 1, ancestors);
+        }
+    }
+};
+
+inline void FilePath::walk(const FilePath& root, const std::function<bool(const DirectoryEntry&, int)>& visitor, unsigned threads)
+{
+    WalkOptions options;
+    options.threads = threads;
+    DirectoryWalker::walk(root, visitor, options);
+}
+
+inline void FilePath::walk(const FilePath& root, const std::function<bool(const DirectoryEntry&, int)>& visitor, const WalkOptions& options)
+{
+    DirectoryWalker::walk(root, visitor, options);
+}
+
+/**
+ * @class Glob
+ * @brief ワイルドカードを含むパターンを一度だけコンパイルし、パスとの照合や一致するパスの列挙に用いる
+ * 
+ * 記法は '*' (0文字以上), '?' (任意の1文字), "[abc]" "[a-z]" "[!a-z]" (文字集合) で、いずれも区切り文字には一致しない。
+ * コンポーネント全体が "**" の場合は0個以上のディレクトリに一致する。POSIX のパターンでは '\\' で次の1文字をエスケープできる。
+ * '.' で始まる名前も区別せずに一致する。
+ * 
+ * コンパイル時にコンポーネントをリテラル, ワイルドカード, "**" に分類し、ワイルドカードは先頭と末尾のリテラル部分を
+ * 取り出しておく ("*.log" は末尾の ".log" の比較だけで判定できる)。
+ * expand() はパターンを状態とする NFA をディレクトリ木の上で進めるため、リテラルのコンポーネントは一覧を読まずに直接開き、
+ * どの状態にも一致しないディレクトリには降りない。
+ */
+class Glob
+{
+public:
+    Glob()
+     :  platform_(FilePath::NATIVE), root_(), components_()
+    {}
+
+    explicit Glob(const std::string& pattern, FilePath::Platform platform = FilePath::NATIVE)
+     :  platform_(platform), root_(), components_()
+    {
+        compile(pattern);
+    }
+
+    /**
+     * @brief パターンが絶対パスか否か (絶対パスの場合、expand() は base を無視してルートから列挙する)
+     */
+    bool is_absolute() const
+    {
+        return !root_.empty();
+    }
+
+    /**
+     * @brief ワイルドカードを含まないか否か (全てのコンポーネントがリテラル)
+     */
+    bool is_literal() const
+    {
+        for (std::size_t i = 0; i < components_.size(); ++i)
+        {
+            if (components_[i].kind != Component::LITERAL)
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief パス全体がパターンに一致するか否か
+     * 
+     * 相対パターンはパスのコンポーネント列に対して照合する。絶対パターンはルートも一致する必要がある。
+     * FilePath::walk の visitor 内で、root からの相対パスを渡して絞り込む用途にも使える。
+     * 
+     * @param path 照合するパス
+     * @return bool 
+     */
+    bool match(const FilePathView& path) const
+    {
+        if (!match_root(path))
+            return false;
+        std::vector<FilePathView> names;
+        for (FilePathView::const_iterator it = path.begin(), last = path.end(); it != last; ++it)
+            names.push_back(*it);
+
+        // '*' と同じく、最後に現れた "**" の位置だけを記録して後戻りする
+        const std::size_t count = components_.size();
+        std::size_t c = 0;
+        std::size_t n = 0;
+        std::size_t star = NONE;
+        std::size_t star_name = 0;
+        while (n < names.size())
+        {
+            if (c < count && components_[c].kind == Component::RECURSIVE)
+            {
+                star = c++;
+                star_name = n;
+            }
+            else if (c < count && match_component(components_[c], names[n].data(), names[n].size()))
+            {
+                ++c;
+                ++n;
+            }
+            else if (star != NONE)
+            {
+                c = star + 1;
+                n = ++star_name;
+            }
+            else
+                return false;
+        }
+        while (c < count && components_[c].kind == Component::RECURSIVE)
+            ++c;
+        return c == count;
+    }
+
+    /**
+     * @brief パターンと path のルートが一致するか否か (ドライブレターは大文字・小文字を区別しない)
+     */
+    bool match_root(const FilePathView& path) const
+    {
+        if (is_absolute() != path.is_absolute())
+            return false;
+        const bool has_drive = path.platform() == FilePath::WINDOWS && path.is_absolute();
+        if ((root_.size() == 3) != has_drive)
+            return false;
+        return !has_drive || std::toupper(static_cast<unsigned char>(root_[0])) == std::toupper(static_cast<unsigned char>(path.data()[0]));
+    }
+
+    /**
+     * @brief 1つのコンポーネント (ファイル名) が index 番目のパターンに一致するか否か
+     */
+    bool match_component(std::size_t index, const FilePathView& name) const
+    {
+        return index < components_.size() && match_component(components_[index], name.data(), name.size());
+    }
+
+    std::size_t size() const
+    {
+        return components_.size();
+    }
+
+    /**
+     * @brief パターンに一致するパスを列挙する
+     * 
+     * ディレクトリ1つの読み出しを1タスクとして WorkStealingPool で並列に処理する。
+     * 
+     * @param base 相対パターンの起点 (空の場合はカレントディレクトリで、結果も相対パスとなる)
+     * @param options threads と follow_symlinks ("**" がディレクトリへのシンボリックリンクを辿るか否か) を用いる
+     * @return std::vector<FilePath> 昇順に整列した結果
+     */
+    std::vector<FilePath> expand(const FilePath& base = FilePath(), const WalkOptions& options = WalkOptions()) const;
+
+private:
+    static const std::size_t NONE = static_cast<std::size_t>(-1);
+
+    struct Token
+    {
+        enum Type { CHAR, ANY, STAR, SET };
+
+        Type type;
+        char c;
+        uint64_t set[4];    /**< SET の場合に一致するバイトのビット集合 */
+
+        bool matches(char ch) const
+        {
+            const unsigned char u = static_cast<unsigned char>(ch);
+            switch (type)
+            {
+            case CHAR:  return ch == c;
+            case SET:   return (set[u >> 6] >> (u & 63)) & 1;
+            default:    return true;
+            }
+        }
+    };
+
+    struct Component
+    {
+        enum Kind { LITERAL, WILDCARD, RECURSIVE };
+
+        Kind kind;
+        std::string prefix;     /**< LITERAL では名前全体、WILDCARD では先頭のリテラル部分 */
+        std::string suffix;     /**< WILDCARD の末尾のリテラル部分 */
+        std::vector<Token> tokens;      /**< prefix と suffix を除いた中間部分 */
+        bool star_only;         /**< 中間部分が '*' のみ ("*.log" など) */
+
+        Component()
+         :  kind(LITERAL), prefix(), suffix(), tokens(), star_only(false)
+        {}
+    };
+
+    /** @brief expand() で状態の集合を1つのディレクトリに対して適用するタスク */
+    class Expander;
+
+    FilePath::Platform platform_;
+    std::string root_;
+    std::vector<Component> components_;
+
+    bool is_separator(char c) const
+    {
+        return c == '/' || (platform_ == FilePath::WINDOWS && c == '\\');
+    }
+
+    /**
+     * @brief parent の直下の name (parent が空の場合は name だけの相対パス)
+     */
+    static FilePath child(const FilePath& parent, const char* name, std::size_t size)
+    {
+        FilePath result(parent);
+        result.append_component(name, size);
+        return result;
+    }
+
+    void compile(const std::string& pattern)
+    {
+        std::size_t pos = 0;
+        if (platform_ == FilePath::WINDOWS && FilePath::has_drive(pattern.data(), pattern.size()))
+            pos = 3;
+        else if (!pattern.empty() && is_separator(pattern[0]))
+            pos = 1;
+        root_ = pattern.substr(0, pos);
+
+        while (pos < pattern.size())
+        {
+            std::size_t last = pos;
+            while (last < pattern.size() && !is_separator(pattern[last]))
+            {
+                if (pattern[last] == '\\' && platform_ != FilePath::WINDOWS && last + 1 < pattern.size())
+                    ++last;
+                ++last;
+            }
+            if (last > pos)
+                components_.push_back(compile_component(pattern, pos, last));
+            pos = last + 1;
+        }
+    }
+
+    Component compile_component(const std::string& pattern, std::size_t pos, std::size_t last) const
+    {
+        Component component;
+        if (last - pos == 2 && pattern[pos] == '*' && pattern[pos + 1] == '*')
+        {
+            component.kind = Component::RECURSIVE;
+            return component;
+        }
+
+        std::vector<Token> tokens;
+        bool literal = true;
+        while (pos < last)
+        {
+            Token token;
+            token.type = Token::CHAR;
+            token.c = pattern[pos++];
+            std::memset(token.set, 0, sizeof(token.set));
+            if (token.c == '\\' && platform_ != FilePath::WINDOWS && pos < last)
+                token.c = pattern[pos++];
+            else if (token.c == '*')
+                token.type = Token::STAR;
+            else if (token.c == '?')
+                token.type = Token::ANY;
+            else if (token.c == '[')
+                pos = compile_set(pattern, pos, last, token);
+
+            if (token.type == Token::STAR && !tokens.empty() && tokens.back().type == Token::STAR)
+                continue;       // "**" をコンポーネントの一部に含む場合は '*' と同じ
+            literal = literal && token.type == Token::CHAR;
+            tokens.push_back(token);
+        }
+
+        std::size_t head = 0;
+        while (head < tokens.size() && tokens[head].type == Token::CHAR)
+            component.prefix += tokens[head++].c;
+        if (literal)
+            return component;
+
+        std::size_t tail = tokens.size();
+        while (tail > head && tokens[tail - 1].type == Token::CHAR)
+            --tail;
+        for (std::size_t i = tail; i < tokens.size(); ++i)
+            component.suffix += tokens[i].c;
+        component.kind = Component::WILDCARD;
+        component.tokens.assign(tokens.begin() + head, tokens.begin() + tail);
+        component.star_only = component.tokens.size() == 1 && component.tokens[0].type == Token::STAR;
+        return component;
+    }
+
+    /**
+     * @brief '[' の直後から文字集合を読み取る (']' で閉じていない場合は '[' をリテラルとして扱う)
+     * 
+     * @return std::size_t 読み取った後の位置
+     */
+    std::size_t compile_set(const std::string& pattern, std::size_t pos, std::size_t last, Token& token) const
+    {
+        std::size_t i = pos;
+        const bool negate = i < last && (pattern[i] == '!' || pattern[i] == '^');
+        if (negate)
+            ++i;
+        const std::size_t first = i;
+        uint64_t set[4] = { 0, 0, 0, 0 };
+        for (; i < last && (pattern[i] != ']' || i == first); ++i)
+        {
+            unsigned lo = static_cast<unsigned char>(pattern[i]);
+            unsigned hi = lo;
+            if (i + 2 < last && pattern[i + 1] == '-' && pattern[i + 2] != ']')
+            {
+                hi = static_cast<unsigned char>(pattern[i + 2]);
+                i += 2;
+            }
+            for (unsigned u = lo; u <= hi; ++u)
+                set[u >> 6] |= uint64_t(1) << (u & 63);
+        }
+        if (i >= last)
+            return pos;
+
+        token.type = Token::SET;
+        for (int w = 0; w < 4; ++w)
+            token.set[w] = negate ? ~set[w] : set[w];
+        // 区切り文字には一致しない
+        token.set['/' >> 6] &= ~(uint64_t(1) << ('/' & 63));
+        if (platform_ == FilePath::WINDOWS)
+            token.set['\\' >> 6] &= ~(uint64_t(1) << ('\\' & 63));
+        return i + 1;
+    }
+
+    static bool match_component(const Component& component, const char* name, std::size_t size)
+    {
+        const std::size_t head = component.prefix.size();
+        if (component.kind == Component::LITERAL)
+            return size == head && std::memcmp(name, component.prefix.data(), size) == 0;
+        if (component.kind == Component::RECURSIVE)
+            return true;
+
+        const std::size_t tail = component.suffix.size();
+        if (size < head + tail
+            || std::memcmp(name, component.prefix.data(), head) != 0
+            || std::memcmp(name + size - tail, component.suffix.data(), tail) != 0)
+            return false;
+        if (component.star_only)
+            return true;
+        return match_tokens(component.tokens, name + head, size - head - tail);
+    }
+
+    /**
+     * @brief '*' を含むトークン列の照合。最後に現れた '*' の位置だけを記録して後戻りするため、O(トークン数 × 文字数) で終わる
+     */
+    static bool match_tokens(const std::vector<Token>& tokens, const char* name, std::size_t size)
+    {
+        std::size_t t = 0;
+        std::size_t n = 0;
+        std::size_t star = NONE;
+        std::size_t star_name = 0;
+        while (n < size)
+        {
+            if (t < tokens.size() && tokens[t].type == Token::STAR)
+            {
+                star = t++;
+                star_name = n;
+            }
+            else if (t < tokens.size() && tokens[t].matches(name[n]))
+            {
+                ++t;
+                ++n;
+            }
+            else if (star != NONE)
+            {
+                t = star + 1;
+                n = ++star_name;
+            }
+            else
+                return false;
+        }
+        while (t < tokens.size() && tokens[t].type == Token::STAR)
+            ++t;
+        return t == tokens.size();
+    }
+
+    /**
+     * @brief "**" は0個のディレクトリにも一致するため、その次の状態も加える (states は昇順に保つ)
+     */
+    void close_states(std::vector<unsigned>& states, unsigned state) const
+    {
+        for (;;)
+        {
+            std::vector<unsigned>::iterator it = std::lower_bound(states.begin(), states.end(), state);
+            if (it != states.end() && *it == state)
+                return;
+            states.insert(it, state);
+            if (state >= components_.size() || components_[state].kind != Component::RECURSIVE)
+                return;
+            ++state;
+        }
+    }
+};
+
+/**
+ * 状態 (次に照合するコンポーネントの添字。components_.size() はパターン全体に一致したことを表す) の集合を
+ * ディレクトリ1つに適用し、一致したパスを結果へ、状態が残る子ディレクトリを新たなタスクとして積む。
+ */
+class Glob::Expander
+{
+public:
+    Expander(const Glob& glob, const WalkOptions& options)
+     :  glob_(glob), options_(options), pool_(options.threads), mutex_(), result_()
+    {}
+
+    std::vector<FilePath> run(const FilePath& base)
+    {
+        std::vector<unsigned> states;
+        glob_.close_states(states, 0);
+        const unsigned end = static_cast<unsigned>(glob_.components_.size());
+        if (std::binary_search(states.begin(), states.end(), end) && (glob_.is_absolute() || !base.to_str().empty()))
+            result_.push_back(glob_.is_absolute() ? FilePath(glob_.root_) : base);
+
+        const FilePath display = glob_.is_absolute() ? FilePath(glob_.root_) : base;
+        FilePath directory = display;
+        if (directory.to_str().empty())
+            directory = FilePath(".");
+        std::shared_ptr<DirectoryHandle> handle(new DirectoryHandle(directory));
+        pool_.spawn(0, [this, handle, display, states](std::size_t worker)
+        {
+            scan(worker, handle, display, states, AncestorChain::Ptr());
+        });
+        pool_.run();
+        std::sort(result_.begin(), result_.end());
+        result_.erase(std::unique(result_.begin(), result_.end()), result_.end());
+        return std::move(result_);
+    }
+
+private:
+    const Glob& glob_;
+    const WalkOptions options_;
+    WorkStealingPool pool_;
+    std::mutex mutex_;
+    std::vector<FilePath> result_;
+
+    Expander(const Expander&);
+    Expander& operator=(const Expander&);
+
+    void emit(const FilePath& path)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        result_.push_back(path);
+    }
+
+    /**
+     * @brief 名前 name に一致した状態を1つ進めた集合
+     */
+    std::vector<unsigned> advance(const std::vector<unsigned>& states, const char* name, std::size_t size) const
+    {
+        std::vector<unsigned> next;
+        const std::size_t end = glob_.components_.size();
+        for (std::size_t i = 0; i < states.size(); ++i)
+        {
+            const unsigned state = states[i];
+            if (state == end)
+                continue;
+            const Glob::Component& component = glob_.components_[state];
+            if (component.kind == Glob::Component::RECURSIVE)
+                glob_.close_states(next, state);       // "**" が name を消費する (降りるのはディレクトリの場合のみ)
+            else if (Glob::match_component(component, name, size))
+                glob_.close_states(next, state + 1);
+        }
+        return next;
+    }
+
+    void descend(std::size_t worker, std::shared_ptr<DirectoryHandle> parent, const FilePath& path, const std::string& name, const std::vector<unsigned>& states,
+                 const AncestorChain::Ptr& ancestors)
+    {
+        pool_.spawn(worker, [this, parent, path, name, states, ancestors](std::size_t current) mutable
+        {
+            std::shared_ptr<DirectoryHandle> handle(new DirectoryHandle(parent->open_directory(name.c_str())));
+            parent.reset();
+            scan(current, handle, path, states, ancestors);
+        });
+    }
+
+    /**
+     * @param ancestors follow_symlinks 時に "**" で辿った handle の祖先 (循環できるのは "**" を経由する場合のみ)
+     */
+    void scan(std::size_t worker, const std::shared_ptr<DirectoryHandle>& handle, const FilePath& path, const std::vector<unsigned>& states,
+              AncestorChain::Ptr ancestors)
+    {
+        if (!handle->is_open())
+            return;
+        const unsigned end = static_cast<unsigned>(glob_.components_.size());
+
+        bool literal = true;
+        for (std::size_t i = 0; i < states.size() && literal; ++i)
+            literal = states[i] == end || glob_.components_[states[i]].kind == Glob::Component::LITERAL;
+
+        if (literal)
+        {
+            // 一覧を読まずに、リテラルの名前を直接 stat / open する
+            for (std::size_t i = 0; i < states.size(); ++i)
+            {
+                if (states[i] == end)
+                    continue;
+                const std::string& name = glob_.components_[states[i]].prefix;
+                std::vector<unsigned> next;
+                glob_.close_states(next, states[i] + 1);
+                const bool matched = std::binary_search(next.begin(), next.end(), end);
+                if (matched && next.size() == 1)
+                {
+                    if (handle->symlink_status(name.c_str()).exists())
+                        emit(Glob::child(path, name.data(), name.size()));
+                    continue;
+                }
+                const FileStatus st = handle->status(name.c_str());
+                if (matched && (st.exists() || handle->symlink_status(name.c_str()).exists()))
+                    emit(Glob::child(path, name.data(), name.size()));
+                if (st.type() == FileStatus::DIRECTORY)
+                    descend(worker, handle, Glob::child(path, name.data(), name.size()), name, next, ancestors);
+            }
+            return;
+        }
+
+        bool recursive = false;
+        for (std::size_t i = 0; i < states.size(); ++i)
+            recursive = recursive || (states[i] != end && glob_.components_[states[i]].kind == Glob::Component::RECURSIVE);
+        if (recursive && options_.follow_symlinks)
+        {
+            const FileStatus st = handle->status();
+            if (AncestorChain::contains(ancestors, st))
+                return;             // 祖先へのリンクで循環している
+            ancestors = AncestorChain::push(ancestors, st);
+        }
+
+        for (DirectoryIterator it(*handle), last; it != last; ++it)
+        {
+            const DirectoryEntry& entry = *it;
+            const FilePathView name = entry.path().view().filename();
+            // "**" が辿るのはディレクトリ自身のみ。リテラルやワイルドカードの照合で降りる場合はリンクも辿る
+            const bool is_directory = (options_.follow_symlinks || !recursive) ? entry.is_directory() : entry.type() == FileStatus::DIRECTORY;
+            std::vector<unsigned> next = advance(states, name.data(), name.size());
+            if (next.empty())
+                continue;
+            const FilePath entry_path = Glob::child(path, name.data(), name.size());
+            if (next.back() == end)
+            {
+                emit(entry_path);
+                next.pop_back();
+            }
+            if (!next.empty() && is_directory)
+                descend(worker, handle, entry_path, entry.filename(), next, ancestors);
+        }
+    }
+};
+
+inline std::vector<FilePath> Glob::expand(const FilePath& base, const WalkOptions& options) const
+{
+    Expander expander(*this, options);
+    return expander.run(base);
+}
+
+inline std::vector<FilePath> FilePath::glob(const std::string& pattern, const FilePath& base, unsigned threads)
+{
+    WalkOptions options;
+    options.threads = threads;
+    return Glob(pattern).expand(base, options);
+}
+
+/**
+ * @class DirectoryRemover
+ * @brief FilePath::remove_all の実装。ディレクトリ1つの削除を1タスクとして WorkStealingPool で並列に行う
+ * 
+ * 各ディレクトリは未削除の配下ディレクトリ数 (+ 自身の走査) を数え、0 になった時点で
+ * 親のハンドルからディレクトリ自身を削除して親の数を減らす (後順)。
+ * 開けなかったディレクトリも削除を試み (空であれば削除できる) 、失敗した場合に限り、開けなかった際のエラーで1件と数える。
+ */
+class DirectoryRemover
+{
+public:
+    static FileOperationResult remove_all(const FilePath& path, unsigned threads)
+    {
+        DirectoryRemover remover(path, threads);
+        const FileStatus st = path.symlink_status();
+        if (st.type() == FileStatus::NOT_FOUND)
+            return remover.result();
+        if (st.type() != FileStatus::DIRECTORY)
+        {
+            if (path.remove_file())
+                ++remover.count_;
+            else
+                remover.fail(path.native());
+            return remover.result();
+        }
+
+        std::shared_ptr<Node> root(new Node(std::shared_ptr<Node>(), std::string()));
+        remover.pool_.spawn(0, [&remover, root](std::size_t worker)
+        {
+            root->handle.reset(new DirectoryHandle(remover.path_));
+            remover.scan(worker, root);
+        });
+        remover.pool_.run();
+        return remover.result();
+    }
+
+private:
+    struct Node
+    {
+        std::shared_ptr<Node> parent;
+        std::string name;                           /**< 親ディレクトリ内での名前 (ルートは空) */
+        std::shared_ptr<DirectoryHandle> handle;
+        std::atomic<std::size_t> pending;           /**< 未削除の配下ディレクトリ数 + 走査中であれば 1 */
+        int open_error;                             /**< 開けなかった場合のエラー番号 (開けた場合は 0) */
+
+        Node(const std::shared_ptr<Node>& parent, const std::string& name)
+         :  parent(parent), name(name), handle(), pending(1), open_error(0)
+        {}
+    };
+
+    const FilePath& path_;
+    WorkStealingPool pool_;
+    std::atomic<std::size_t> count_;
+    std::atomic<std::size_t> failures_;
+    std::mutex error_mutex_;
+    int error_;
+    std::string error_path_;
+
+    DirectoryRemover(const FilePath& path, unsigned threads)
+     :  path_(path), pool_(threads), count_(0), failures_(0), error_mutex_(), error_(0), error_path_()
+    {}
+
+    FileOperationResult result() const
+    {
+        FileOperationResult result;
+        result.count      = count_;
+        result.failures   = failures_;
+        result.error      = error_;
+        result.error_path = error_path_;
+        return result;
+    }
+
+    void fail(const std::string& path)
+    {
+        fail(path, FilePath::last_error());
+    }
+
+    void fail(const std::string& path, int error)
+    {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        if (failures_++ == 0)
+        {
+            error_ = error;
+            error_path_ = path;
+        }
+    }
+
+    void spawn(std::size_t worker, const std::shared_ptr<Node>& node)
+    {
+        pool_.spawn(worker, [this, node](std::size_t current)
+        {
+            const DirectoryHandle& parent = *node->parent->handle;
+            node->handle.reset(new DirectoryHandle(parent.open_directory(node->name.c_str())));
+            if (!node->handle->is_open())
+                *node->handle = DirectoryHandle(node->handle->path());    // fd の枯渇時などはフルパスで再試行する
+            scan(current, node);
+        });
+    }
+
+    void scan(std::size_t worker, const std::shared_ptr<Node>& node)
+    {
+        const DirectoryHandle& handle = *node->handle;
+        if (handle.is_open())
+        {
+            for (DirectoryIterator it(handle), last; it != last; ++it)
+            {
+                const DirectoryEntry& entry = *it;
+                const std::string name = entry.filename();
+                if (entry.type() == FileStatus::DIRECTORY)
+                {
+                    ++node->pending;
+                    spawn(worker, std::make_shared<Node>(node, name));
+                }
+                else if (handle.remove_file(name.c_str()))
+                {
+                    ++count_;
+                }
+                else
+                {
+                    fail(entry.path().native());
+                }
+            }
+        }
+        else
+        {
+            node->open_error = FilePath::last_error();      // 失敗として数えるのは finish() で削除できなかった場合のみ
+        }
+        finish(node);
+    }
+
+    void finish(std::shared_ptr<Node> node)
+    {
+        while (node && --node->pending == 0)
+        {
+            const std::string path = node->handle->path().native();
+            node->handle.reset();
+            const bool removed = node->parent ? node->parent->handle->remove_directory(node->name.c_str()) : remove_directory(path_);
+            if (removed)
+                ++count_;
+            else if (node->open_error != 0)
+                fail(path, node->open_error);
+            else
+                fail(path);
+            node = node->parent;
+        }
+    }
+
+    static bool remove_directory(const FilePath& path)
+    {
+        FILE_PATH_TRACE(REMOVE);
+#ifdef __unix__
+        return rmdir(path.c_str()) == 0;
+#else
+        return RemoveDirectoryW(path.win32_path().c_str()) != 0;
+#endif
+    }
+
+    DirectoryRemover(const DirectoryRemover&);
+    DirectoryRemover& operator=(const DirectoryRemover&);
+};
+
+inline FileOperationResult FilePath::remove_all(const FilePath& path, unsigned threads)
+{
+    return DirectoryRemover::remove_all(path, threads);
+}
+
+inline bool FilePath::copy_tree(const FilePath& from, const FilePath& to, const WalkOptions& options, bool overwrite)
+{
+    if (!create_directory(to) && !to.is_directory())
+        return false;
+
+    // walk が返すエントリのパスは from の文字列の後に区切り文字を挟んで続く
+    const std::size_t prefix = from.empty() ? from.path_.size() : from.path_.size() + 1;
+    std::atomic<bool> ok(true);
+    std::atomic<int> error(0);          // 複製はワーカースレッドで行うため、最初の失敗のエラー番号を呼び出し元へ持ち帰る
+    const auto fail = [&]()
+    {
+        int expected = 0;
+        error.compare_exchange_strong(expected, last_error());
+        ok = false;
+    };
+    walk(from, [&](const DirectoryEntry& entry, int) -> bool
+    {
+        FilePath target(to);
+        target.append_component(entry.path().path_.data() + prefix, entry.path().path_.size() - prefix);
+
+        const bool is_directory = options.follow_symlinks ? entry.is_directory() : entry.type() == FileStatus::DIRECTORY;
+        if (is_directory)
+        {
+            if (create_directory(target) || target.is_directory())
+                return true;
+            fail();
+            return false;
+        }
+#ifdef __unix__
+        if (entry.is_symlink() && !options.follow_symlinks)
+        {
+            char link[PATH_MAX];
+            const ssize_t length = readlink(entry.path().c_str(), link, sizeof(link) - 1);
+            if (length < 0)
+            {
+                fail();
+                return false;
+            }
+            link[length] = '\0';
+            if (overwrite)
+                unlink(target.c_str());
+            if (symlink(link, target.c_str()) != 0)
+                fail();
+            return false;
+        }
+#endif
+        if (entry.is_file() && !entry.path().copy_file(target, overwrite))
+            fail();
+        return false;
+    }, options);
+    if (!ok)
+        set_last_error(error);
+    return ok;
+}
+
+/**
+ * @struct DiskUsage
+ * @brief FilePath::disk_usage の結果。ディレクトリごとの集計を木構造で保持する
+ * 
+ * 各値は自身と配下全体の合計で、max_depth より深いディレクトリの分も最も近い祖先に含まれる。
+ */
+struct DiskUsage
+{
+    FilePath path;
+    uint64_t size;                      /**< 論理サイズの合計 [byte] */
+    uint64_t allocated;                 /**< 割り当て済み容量の合計 [byte] (取得できない場合は論理サイズで代用する) */
+    uint64_t files;                     /**< ディレクトリ以外のエントリ数 (ハードリンクも名前ごとに数える) */
+    uint64_t directories;               /**< 自身を含むディレクトリ数 */
+    uint64_t errors;                    /**< 開けなかったディレクトリと属性を取得できなかったエントリの数 */
+    std::vector<DiskUsage> children;    /**< 子ディレクトリの集計 (パスの昇順) */
+
+    DiskUsage()
+     :  path(), size(0), allocated(0), files(0), directories(0), errors(0), children()
+    {}
+};
+
+/**
+ * @class DiskUsageScanner
+ * @brief FilePath::disk_usage の実装。ディレクトリ1つの集計を1タスクとして WorkStealingPool で並列に行う
+ * 
+ * DirectoryRemover と同じく各ディレクトリは未集計の配下ディレクトリ数 (+ 自身の走査) を数え、0 になった時点で
+ * 自身の合計を親のカウンタへ加算する (後順)。カウンタは std::atomic への加算のみで更新し、ロックを取らない。
+ * max_depth より深いディレクトリはノードを作らず、最も近い祖先のカウンタへ直接加算する。
+ * ハードリンク (link_count() > 1) は (device, inode) を inode で分割したセットへ記録し、初出の名前のみ容量を数える。
+ */
+class DiskUsageScanner
+{
+public:
+    static DiskUsage scan(const FilePath& root, const DiskUsageOptions& options)
+    {
+        DiskUsage result;
+        const FileStatus st = root.status();
+        if (st.type() != FileStatus::DIRECTORY)
+        {
+            result.path = root;
+            if (st.exists())
+            {
+                result.files = 1;
+                result.size = bytes(st.size());
+                result.allocated = allocated_bytes(st);
+            }
+            else
+            {
+                result.errors = 1;
+            }
+            return result;
+        }
+
+        DiskUsageScanner scanner(st.device(), options);
+        Node node(NULL);
+        node.path = root;
+        scanner.pool_.spawn(0, [&scanner, &node, root](std::size_t worker)
+        {
+            std::shared_ptr<DirectoryHandle> handle(new DirectoryHandle(root));
+            scanner.scan(worker, handle, &node, 0);
+        });
+        scanner.pool_.run();
+        convert(node, result);
+        return result;
+    }
+
+private:
+    struct Node
+    {
+        Node* parent;
+        FilePath path;
+        std::vector<std::unique_ptr<Node> > children;   /**< このノードを走査するタスクのみが追加する */
+        std::atomic<uint64_t> size;
+        std::atomic<uint64_t> allocated;
+        std::atomic<uint64_t> files;
+        std::atomic<uint64_t> directories;
+        std::atomic<uint64_t> errors;
+        std::atomic<std::size_t> pending;               /**< 未集計の配下ディレクトリ数 + 走査中であれば 1 */
+        bool excluded;                                  /**< one_file_system により除外した */
+
+        explicit Node(Node* parent)
+         :  parent(parent), path(), children(), size(0), allocated(0), files(0), directories(0), errors(0), pending(1), excluded(false)
+        {}
+    };
+
+    struct Totals
+    {
+        uint64_t size;
+        uint64_t allocated;
+        uint64_t files;
+        uint64_t directories;
+        uint64_t errors;
+
+        Totals()
+         :  size(0), allocated(0), files(0), directories(0), errors(0)
+        {}
+    };
+
+    static const std::size_t LINK_SHARDS = 16;
+
+    struct LinkShard
+    {
+        std::mutex mutex;
+        std::set<std::pair<uint64_t, uint64_t> > inodes;    /**< (device, inode) */
+    };
+
+    const uint64_t device_;
+    const DiskUsageOptions options_;
+    WorkStealingPool pool_;
+    LinkShard links_[LINK_SHARDS];
+
+    DiskUsageScanner(uint64_t device, const DiskUsageOptions& options)
+     :  device_(device), options_(options), pool_(options.threads)
+    {}
+
+    DiskUsageScanner(const DiskUsageScanner&);
+    DiskUsageScanner& operator=(const DiskUsageScanner&);
+
+    bool retains(int depth) const
+    {
+        return options_.max_depth < 0 || depth <= options_.max_depth;
+    }
+
+    /**
+     * 子ディレクトリは親のハンドルからの openat で開く。集計先は子自身のノードか、保持しない深さであれば node となる。
+     */
+    void spawn(std::size_t worker, std::shared_ptr<DirectoryHandle> parent, Node* node, const std::string& name, int depth)
+    {
+        Node* target = node;
+        if (retains(depth))
+        {
+            node->children.push_back(std::unique_ptr<Node>(new Node(node)));
+            target = node->children.back().get();
+        }
+        ++node->pending;
+        pool_.spawn(worker, [this, parent, target, name, depth](std::size_t current) mutable
+        {
+            std::shared_ptr<DirectoryHandle> handle(new DirectoryHandle(parent->open_directory(name.c_str())));
+            parent.reset();
+            if (!handle->is_open())
+                *handle = DirectoryHandle(handle->path());    // fd の枯渇時などはフルパスで再試行する
+            if (retains(depth))
+                target->path = handle->path();
+            scan(current, handle, target, depth);
+        });
+    }
+
+    void scan(std::size_t worker, const std::shared_ptr<DirectoryHandle>& handle, Node* node, int depth)
+    {
+        Totals totals;
+        if (handle->is_open())
+        {
+            const FileStatus self = handle->status();
+            if (options_.one_file_system && self.device() != device_)
+            {
+                if (retains(depth))
+                    node->excluded = true;
+                finish(node);
+                return;
+            }
+            ++totals.directories;
+            add(totals, self);
+
+            for (DirectoryIterator it(*handle), last; it != last; ++it)
+            {
+                const DirectoryEntry& entry = *it;
+                if (entry.type() == FileStatus::DIRECTORY)
+                {
+                    spawn(worker, handle, node, entry.filename(), depth + 1);
+                    continue;
+                }
+#ifdef __unix__
+                const FileStatus st = handle->symlink_status(entry.filename().c_str());
+#else
+                const FileStatus st = entry.symlink_status();
+#endif
+                if (st.type() == FileStatus::NOT_FOUND)
+                    continue;       // 走査中に削除された
+                if (!st.exists())
+                {
+                    ++totals.errors;
+                    continue;
+                }
+                ++totals.files;
+                if (options_.dedupe_hard_links && st.link_count() > 1 && !first_link(st))
+                    continue;
+                add(totals, st);
+            }
+        }
+        else
+        {
+            ++totals.errors;
+        }
+
+        node->size          += totals.size;
+        node->allocated     += totals.allocated;
+        node->files         += totals.files;
+        node->directories   += totals.directories;
+        node->errors        += totals.errors;
+        finish(node);
+    }
+
+    static void finish(Node* node)
+    {
+        while (node != NULL && --node->pending == 0)
+        {
+            Node* parent = node->parent;
+            if (parent != NULL)
+            {
+                parent->size        += node->size;
+                parent->allocated   += node->allocated;
+                parent->files       += node->files;
+                parent->directories += node->directories;
+                parent->errors      += node->errors;
+            }
+            node = parent;
+        }
+    }
+
+    bool first_link(const FileStatus& st)
+    {
+        LinkShard& shard = links_[st.inode() % LINK_SHARDS];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.inodes.insert(std::make_pair(st.device(), st.inode())).second;
+    }
+
+    static void add(Totals& totals, const FileStatus& st)
+    {
+        totals.size       += bytes(st.size());
+        totals.allocated  += allocated_bytes(st);
+    }
+
+    static uint64_t bytes(int64_t size)
+    {
+        return (size < 0) ? 0 : static_cast<uint64_t>(size);
+    }
+
+    static uint64_t allocated_bytes(const FileStatus& st)
+    {
+        return (st.allocated() < 0) ? bytes(st.size()) : static_cast<uint64_t>(st.allocated());
+    }
+
+    static void convert(const Node& node, DiskUsage& result)
+    {
+        result.path         = node.path;
+        result.size         = node.size;
+        result.allocated    = node.allocated;
+        result.files        = node.files;
+        result.directories  = node.directories;
+        result.errors       = node.errors;
+        for (std::size_t i = 0; i < node.children.size(); ++i)
+        {
+            if (node.children[i]->excluded)
+                continue;
+            result.children.push_back(DiskUsage());
+            convert(*node.children[i], result.children.back());
+        }
+        std::sort(result.children.begin(), result.children.end(), [](const DiskUsage& lhs, const DiskUsage& rhs)
+        {
+            return lhs.path < rhs.path;
+        });
+    }
+};
+
+inline DiskUsage FilePath::disk_usage(const FilePath& root, const DiskUsageOptions& options)
+{
+    return DiskUsageScanner::scan(root, options);
+}
+
+/**
+ * @struct WatchEvent
+ * @brief DirectoryWatcher が通知する変更イベント
+ */
+struct WatchEvent
+{
+    enum Type
+    {
+        CREATED = 0,                    /**< 作成された */
+        MODIFIED,                       /**< 内容または属性が変更された */
+        REMOVED,                        /**< 削除された */
+        RENAMED_FROM,                   /**< 名前変更の変更前 (RENAMED_TO とは cookie で対応付ける) */
+        RENAMED_TO,                     /**< 名前変更の変更後 */
+        OVERFLOWED                      /**< カーネルのキューが溢れてイベントが失われた (path は空。再走査が必要) */
+    };
+
+    Type type;
+    FilePath path;
+    bool is_directory;                  /**< 対象がディレクトリか否か (Windows では常に false) */
+    uint32_t cookie;                    /**< 名前変更の対応付け (POSIX のみ。それ以外は 0) */
+
+    WatchEvent()
+     :  type(CREATED), path(), is_directory(false), cookie(0)
+    {}
+
+    WatchEvent(Type type, const FilePath& path, bool is_directory, uint32_t cookie = 0)
+     :  type(type), path(path), is_directory(is_directory), cookie(cookie)
+    {}
+};
+
+#if defined(__linux__) || !defined(__unix__)
+/**
+ * @class DirectoryWatcher
+ * @brief ディレクトリの変更をカーネルから通知させる監視クラス (繰り返し directory_iterator で比較する必要がない)
+ * 
+ * POSIX (Linux) では inotify 、Windows では ReadDirectoryChangesW を用いるため、検出にかかるコストは
+ * ディレクトリの大きさではなく変更の頻度に比例する。イベントは poll() でまとめて取り出すか、
+ * start() で起動したバックグラウンドスレッドからコールバックへまとめて渡される。
+ * 同じパスに連続する MODIFIED は1つにまとめる。再帰的な監視では、Linux の場合は新たに作成された
+ * ディレクトリにも監視を追加し、監視を追加するまでに作成されていたエントリは CREATED として通知する。
+ * inotify を持たない Linux 以外の POSIX 環境では提供しない。
+ */
+class DirectoryWatcher
+{
+public:
+    typedef std::function<void(const std::vector<WatchEvent>& events)> Callback;
+
+    DirectoryWatcher()
+     :
+#ifdef __linux__
+        fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+        wake_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+#else
+        wake_(CreateEventW(NULL, FALSE, FALSE, NULL)),
+        stopping_(false),
+        removals_(),
+#endif
+        mutex_(), watches_(), thread_()
+    {}
+
+    ~DirectoryWatcher()
+    {
+        stop();
+#ifdef __linux__
+        if (fd_ >= 0)
+            ::close(fd_);
+        if (wake_fd_ >= 0)
+            ::close(wake_fd_);
+#else
+        for (std::size_t i = 0; i < watches_.size(); ++i)
+            close_watch(*watches_[i]);
+        if (wake_ != NULL)
+            CloseHandle(wake_);
+#endif
+    }
+
+    bool is_open() const
+    {
+#ifdef __linux__
+        return fd_ >= 0 && wake_fd_ >= 0;
+#else
+        return wake_ != NULL;
+#endif
+    }
+
+    /**
+     * @brief 監視対象のディレクトリを追加する (start() の後でも追加できる)
+     * 
+     * @param directory 監視するディレクトリ
+     * @param recursive 配下のディレクトリも監視するか否か
+     * @return bool 
+     */
+    bool add(const FilePath& directory, bool recursive = false)
+    {
+        if (!is_open())
+            return false;
+#ifdef __linux__
+        return add_watch(directory, directory, recursive, NULL);
+#else
+        std::unique_ptr<Watch> watch(new Watch(directory, recursive));
+        watch->handle = CreateFileW(directory.win32_path().c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+        if (watch->handle == INVALID_HANDLE_VALUE)
+            return false;
+        watch->overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+        if (watch->overlapped.hEvent == NULL || !issue(*watch))
+        {
+            close_watch(*watch);
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        watches_.push_back(std::move(watch));
+        SetEvent(wake_);        // 待機中のスレッドに待機対象を作り直させる
+        return true;
+#endif
+    }
+
+    /**
+     * @brief 監視を解除する (再帰的に追加した場合は配下の監視もまとめて解除する。他の add() が監視しているディレクトリは残す)
+     * 
+     * @param directory add() に渡したディレクトリ
+     * @return bool 監視していなかった場合は false
+     */
+    bool remove(const FilePath& directory)
+    {
+        bool found = false;
+        std::lock_guard<std::mutex> lock(mutex_);
+#ifdef __linux__
+        // 同じディレクトリを別の add() も監視している場合は同じ監視記述子が返されているため、
+        // この add() の所有のみを外し、所有者がいなくなった監視記述子に限り解除する
+        for (std::map<int, Watch>::iterator it = watches_.begin(); it != watches_.end();)
+        {
+            if (it->second.owners.erase(directory) > 0)
+                found = true;
+            if (it->second.owners.empty())
+            {
+                inotify_rm_watch(fd_, it->first);
+                watches_.erase(it++);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+#else
+        for (std::size_t i = 0; i < watches_.size(); ++i)
+        {
+            if (watches_[i]->path == directory)
+            {
+                removals_.push_back(std::move(watches_[i]));
+                watches_.erase(watches_.begin() + i);
+                found = true;
+                break;
+            }
+        }
+        if (found)
+        {
+            if (thread_.joinable())
+                SetEvent(wake_);
+            else
+                drain_removals();
+        }
+#endif
+        return found;
+    }
+
+    /**
+     * @brief 監視しているディレクトリ数
+     */
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return watches_.size();
+    }
+
+#ifdef __linux__
+    /**
+     * @brief inotify の fd (epoll 等の独自のイベントループへ組み込む場合に用いる。読み出しは poll() で行う)
+     */
+    int fd() const
+    {
+        return fd_;
+    }
+#endif
+
+    /**
+     * @brief 溜まっているイベントを events の末尾へまとめて追加する (start() の実行中は呼び出さないこと)
+     * 
+     * @param events イベントの追加先
+     * @param timeout_ms イベントが無い場合に待機する時間 (負の値で無期限、0 で待機しない)
+     * @return std::size_t 追加したイベント数
+     */
+    std::size_t poll(std::vector<WatchEvent>& events, int timeout_ms = 0)
+    {
+        if (!is_open())
+            return 0;
+#ifdef __linux__
+        struct pollfd target;
+        target.fd = fd_;
+        target.events = POLLIN;
+        target.revents = 0;
+        if (::poll(&target, 1, timeout_ms) <= 0)
+            return 0;
+        return read_events(events);
+#else
+        return wait(events, timeout_ms < 0 ? INFINITE : static_cast<DWORD>(timeout_ms));
+#endif
+    }
+
+    /**
+     * @brief バックグラウンドスレッドでイベントを待機し、まとまったイベントごとに callback を呼び出す
+     * 
+     * callback はバックグラウンドスレッドから呼び出されるため、例外を送出してはならない。
+     * 
+     * @param callback イベントを受け取る関数
+     * @return bool 既に起動している場合は false
+     */
+    bool start(const Callback& callback)
+    {
+        if (!is_open() || thread_.joinable())
+            return false;
+#ifndef __linux__
+        stopping_ = false;
+#endif
+        thread_ = std::thread([this, callback]()
+        {
+            std::vector<WatchEvent> events;
+            for (;;)
+            {
+                events.clear();
+#ifdef __linux__
+                struct pollfd targets[2];
+                targets[0].fd = fd_;
+                targets[0].events = POLLIN;
+                targets[0].revents = 0;
+                targets[1].fd = wake_fd_;
+                targets[1].events = POLLIN;
+                targets[1].revents = 0;
+                if (::poll(targets, 2, -1) < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    return;
+                }
+                if (targets[1].revents != 0)
+                    return;
+                read_events(events);
+#else
+                wait(events, INFINITE);
+                if (stopping_)
+                    return;
+#endif
+                if (!events.empty())
+                    callback(events);
+            }
+        });
+        return true;
+    }
+
+    /**
+     * @brief start() で起動したスレッドを停止する
+     */
+    void stop()
+    {
+        if (!thread_.joinable())
+            return;
+#ifdef __linux__
+        uint64_t value = 1;
+        if (write(wake_fd_, &value, sizeof(value)) < 0)
+            return;
+        thread_.join();
+        if (read(wake_fd_, &value, sizeof(value)) < 0)
+            value = 0;
+#else
+        stopping_ = true;
+        SetEvent(wake_);
+        thread_.join();
+#endif
+    }
+
+private:
+#ifdef __linux__
+    struct Watch
+    {
+        FilePath path;
+        std::map<FilePath, bool> owners;    /**< この監視を必要とする add() のディレクトリ → その add() が再帰的か否か */
+
+        Watch()
+         :  path(), owners()
+        {}
+    };
+
+    static const uint32_t MASK = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+    int fd_;
+    int wake_fd_;                       /**< stop() でスレッドを起こすための eventfd */
+    mutable std::mutex mutex_;
+    std::map<int, Watch> watches_;      /**< 監視記述子 → 監視対象 */
+#else
+    struct Watch
+    {
+        FilePath path;
+        bool recursive;
+        HANDLE handle;
+        OVERLAPPED overlapped;
+        DWORD buffer[16 * 1024];        /**< FILE_NOTIFY_INFORMATION は DWORD 境界に並ぶ */
+
+        Watch(const FilePath& path, bool recursive)
+         :  path(path), recursive(recursive), handle(INVALID_HANDLE_VALUE)
+        {
+            std::memset(&overlapped, 0, sizeof(overlapped));
+        }
+    };
+
+    HANDLE wake_;                       /**< stop() や監視対象の変更でスレッドを起こすためのイベント */
+    std::atomic<bool> stopping_;
+    std::vector<std::unique_ptr<Watch> > removals_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Watch> > watches_;
+#endif
+    std::thread thread_;
+
+    static void push(std::vector<WatchEvent>& events, WatchEvent::Type type, const FilePath& path, bool is_directory, uint32_t cookie)
+    {
+        if (type == WatchEvent::MODIFIED && !events.empty() && events.back().type == WatchEvent::MODIFIED && events.back().path == path)
+            return;
+        events.push_back(WatchEvent(type, path, is_directory, cookie));
+    }
+
+#ifdef __linux__
+    bool add_watch(const FilePath& directory, const FilePath& root, bool recursive, std::vector<WatchEvent>* created)
+    {
+        const int wd = inotify_add_watch(fd_, directory.c_str(), MASK);
+        if (wd < 0)
+            return false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Watch& watch = watches_[wd];
+            watch.path = directory;
+            bool& owner_recursive = watch.owners[root];     // 他の所有者の再帰の有無は変えない
+            owner_recursive = owner_recursive || recursive;
+        }
+        if (recursive)
+        {
+            for (DirectoryIterator it(directory), last; it != last; ++it)
+            {
+                const bool is_directory = it->type() == FileStatus::DIRECTORY;
+                if (created != NULL)
+                    created->push_back(WatchEvent(WatchEvent::CREATED, it->path(), is_directory));
+                if (is_directory)
+                    add_watch(it->path(), root, true, created);
+            }
+        }
+        return true;
+    }
+
+    std::size_t read_events(std::vector<WatchEvent>& events)
+    {
+        const std::size_t before = events.size();
+        alignas(struct inotify_event) char buffer[64 * 1024];
+        for (;;)
+        {
+            const ssize_t length = read(fd_, buffer, sizeof(buffer));
+            if (length <= 0)
+                break;
+            for (const char* pos = buffer; pos < buffer + length;)
+            {
+                const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(pos);
+                pos += sizeof(struct inotify_event) + event->len;
+                translate(*event, events);
+            }
+        }
+        return events.size() - before;
+    }
+
+    void translate(const struct inotify_event& event, std::vector<WatchEvent>& events)
+    {
+        if (event.mask & IN_Q_OVERFLOW)
+        {
+            push(events, WatchEvent::OVERFLOWED, FilePath(), false, 0);
+            return;
+        }
+
+        FilePath directory;
+        std::vector<FilePath> recursive_owners;     // 作成されたディレクトリへ監視を広げる add()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::map<int, Watch>::iterator it = watches_.find(event.wd);
+            if (it == watches_.end())
+                return;
+            if (event.mask & IN_IGNORED)
+            {
+                watches_.erase(it);
+                return;
+            }
+            directory = it->second.path;
+            if (event.mask & (IN_CREATE | IN_MOVED_TO))
+            {
+                for (std::map<FilePath, bool>::const_iterator owner = it->second.owners.begin(); owner != it->second.owners.end(); ++owner)
+                {
+                    if (owner->second)
+                        recursive_owners.push_back(owner->first);
+                }
+            }
+        }
+
+        WatchEvent::Type type;
+        if (event.mask & IN_CREATE)
+            type = WatchEvent::CREATED;
+        else if (event.mask & IN_MOVED_TO)
+            type = WatchEvent::RENAMED_TO;
+        else if (event.mask & (IN_MOVED_FROM | IN_MOVE_SELF))
+            type = WatchEvent::RENAMED_FROM;
+        else if (event.mask & (IN_DELETE | IN_DELETE_SELF))
+            type = WatchEvent::REMOVED;
+        else
+            type = WatchEvent::MODIFIED;
+
+        const bool is_directory = (event.mask & IN_ISDIR) != 0 || (event.mask & (IN_DELETE_SELF | IN_MOVE_SELF)) != 0;
+        const FilePath path = (event.len > 0) ? directory / FilePath(event.name) : directory;
+        push(events, type, path, is_directory, event.cookie);
+
+        if (is_directory && (type == WatchEvent::CREATED || type == WatchEvent::RENAMED_TO))
+        {
+            // 配下のエントリの CREATED は最初の所有者の分だけ通知する
+            for (std::size_t i = 0; i < recursive_owners.size(); ++i)
+                add_watch(path, recursive_owners[i], true, i == 0 ? &events : NULL);
+        }
+    }
+#else
+    bool issue(Watch& watch)
+    {
+        const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_ATTRIBUTES;
+        return ReadDirectoryChangesW(watch.handle, watch.buffer, sizeof(watch.buffer), watch.recursive ? TRUE : FALSE, filter, NULL, &watch.overlapped, NULL) != 0;
+    }
+
+    static void close_watch(Watch& watch)
+    {
+        if (watch.handle != INVALID_HANDLE_VALUE)
+        {
+            CancelIoEx(watch.handle, &watch.overlapped);
+            DWORD bytes;
+            GetOverlappedResult(watch.handle, &watch.overlapped, &bytes, TRUE);
+            CloseHandle(watch.handle);
+            watch.handle = INVALID_HANDLE_VALUE;
+        }
+        if (watch.overlapped.hEvent != NULL)
+        {
+            CloseHandle(watch.overlapped.hEvent);
+            watch.overlapped.hEvent = NULL;
+        }
+    }
+
+    /**
+     * @brief 解除を依頼された監視を閉じる (mutex_ を保持した状態で呼び出す)
+     */
+    void drain_removals()
+    {
+        for (std::size_t i = 0; i < removals_.size(); ++i)
+            close_watch(*removals_[i]);
+        removals_.clear();
+    }
+
+    std::size_t wait(std::vector<WatchEvent>& events, DWORD timeout)
+    {
+        std::vector<HANDLE> handles;
+        std::vector<Watch*> targets;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            drain_removals();
+            for (std::size_t i = 0; i < watches_.size() && handles.size() < MAXIMUM_WAIT_OBJECTS - 1; ++i)
+            {
+                handles.push_back(watches_[i]->overlapped.hEvent);
+                targets.push_back(watches_[i].get());
+            }
+        }
+        handles.push_back(wake_);
+
+        const DWORD ret = WaitForMultipleObjects(static_cast<DWORD>(handles.size()), &handles[0], FALSE, timeout);
+        if (ret < WAIT_OBJECT_0 || ret >= WAIT_OBJECT_0 + targets.size())
+            return 0;
+
+        const std::size_t before = events.size();
+        for (std::size_t i = ret - WAIT_OBJECT_0; i < targets.size(); ++i)
+        {
+            Watch& watch = *targets[i];
+            if (WaitForSingleObject(watch.overlapped.hEvent, 0) != WAIT_OBJECT_0)
+                continue;
+            DWORD bytes = 0;
+            const bool ok = GetOverlappedResult(watch.handle, &watch.overlapped, &bytes, FALSE) != 0;
+            ResetEvent(watch.overlapped.hEvent);
+            if (!ok || bytes == 0)
+                push(events, WatchEvent::OVERFLOWED, FilePath(), false, 0);
+            else
+                translate(watch, events);
+            issue(watch);
+        }
+        return events.size() - before;
+    }
+
+    static void translate(const Watch& watch, std::vector<WatchEvent>& events)
+    {
+        const char* pos = reinterpret_cast<const char*>(watch.buffer);
+        for (;;)
+        {
+            const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(pos);
+            WatchEvent::Type type;
+            switch (info->Action)
+            {
+            case FILE_ACTION_ADDED:             type = WatchEvent::CREATED;       break;
+            case FILE_ACTION_REMOVED:           type = WatchEvent::REMOVED;       break;
+            case FILE_ACTION_RENAMED_OLD_NAME:  type = WatchEvent::RENAMED_FROM;  break;
+            case FILE_ACTION_RENAMED_NEW_NAME:  type = WatchEvent::RENAMED_TO;    break;
+            default:                            type = WatchEvent::MODIFIED;      break;
+            }
+            const std::wstring name(info->FileName, info->FileNameLength / sizeof(WCHAR));
+            push(events, type, watch.path / FilePath(name), false, 0);
+            if (info->NextEntryOffset == 0)
+                break;
+            pos += info->NextEntryOffset;
+        }
+    }
+#endif
+
+    DirectoryWatcher(const DirectoryWatcher&);
+    DirectoryWatcher& operator=(const DirectoryWatcher&);
+};
+#endif
+
+/**
+ * @struct StatCacheOptions
+ * @brief StatCache の設定
+ */
+struct StatCacheOptions
+{
+    uint64_t ttl_ms;                    /**< エントリの有効期間 [ms] (0 の場合はキャッシュしない) */
+    unsigned shards;                    /**< 分割数 (ロックはシャード単位) */
+    std::size_t max_entries;            /**< 保持するエントリ数のおおよその上限 (シャードごとに均等に割り当てる) */
+
+    StatCacheOptions()
+     :  ttl_ms(1000), shards(16), max_entries(65536)
+    {}
+};
+
+/**
+ * @class StatCache
+ * @brief FilePath の属性を有効期間付きで保持するキャッシュ (exists(cache) などの述語から利用する)
+ * 
+ * パスのハッシュ値でシャードを選び、シャードごとの std::mutex で保護する。参照は O(1) のハッシュ値と
+ * 文字列比較のみで、期限切れ (または未登録) の場合に限りロックの外で stat を行って登録し直す。
+ * 存在しないという結果もキャッシュするため、設定ファイルの探索のような失敗する問い合わせにも効く。
+ * DirectoryWatcher のイベントを invalidate() へ渡すと、有効期間内でも変更を即座に反映できる。
+ */
+class StatCache
+{
+public:
+    explicit StatCache(const StatCacheOptions& options = StatCacheOptions())
+     :  ttl_ns_(static_cast<int64_t>(options.ttl_ms) * 1000000),
+        shard_capacity_(std::max<std::size_t>(1, options.max_entries / std::max(1u, options.shards))),
+        shards_(std::max(1u, options.shards))
+    {}
+
+    /**
+     * @brief 属性を取得する (有効なエントリがあればシステムコールを行わない)
+     * 
+     * @param path 対象のパス
+     * @param follow_symlink false の場合は symlink_status() 相当となる
+     */
+    FileStatus status(const FilePath& path, bool follow_symlink = true)
+    {
+        Shard& shard = shard_for(path);
+        const int64_t now = clock();
+        uint64_t generation;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            std::unordered_map<FilePath, Entry>::const_iterator it = shard.entries.find(path);
+            if (it != shard.entries.end() && it->second.expires[follow_symlink] > now)
+            {
+                ++shard.hits;
+                return it->second.status[follow_symlink];
+            }
+            ++shard.misses;
+            generation = shard.generation;
+        }
+
+        const FileStatus st = follow_symlink ? path.status() : path.symlink_status();
+        if (ttl_ns_ > 0)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            // stat の間に invalidate() / clear() された場合、変更前の結果を登録し直さない
+            if (shard.generation != generation)
+                return st;
+            if (shard.entries.size() >= shard_capacity_ && shard.entries.find(path) == shard.entries.end())
+                evict(shard, now);
+            Entry& entry = shard.entries[path];
+            entry.status[follow_symlink] = st;
+            entry.expires[follow_symlink] = now + ttl_ns_;
+        }
+        return st;
+    }
+
+    /**
+     * @brief path のエントリを破棄する
+     */
+    void invalidate(const FilePath& path)
+    {
+        Shard& shard = shard_for(path);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        ++shard.generation;
+        shard.invalidations += shard.entries.erase(path);
+    }
+
+    /**
+     * @brief directory 自身とその配下のエントリを全て破棄する (全シャードを走査する)
+     */
+    void invalidate_tree(const FilePath& directory)
+    {
+        const FilePathView prefix = directory.view();
+        for (std::size_t i = 0; i < shards_.size(); ++i)
+        {
+            Shard& shard = shards_[i];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            ++shard.generation;
+            for (std::unordered_map<FilePath, Entry>::iterator it = shard.entries.begin(); it != shard.entries.end(); )
+            {
+                if (it->first.view().starts_with(prefix))
+                {
+                    it = shard.entries.erase(it);
+                    ++shard.invalidations;
+                }
+                else
+                    ++it;
+            }
+        }
+    }
+
+    /**
+     * @brief DirectoryWatcher のイベントに対応するエントリを破棄する
+     * 
+     * 対象のパスに加えて、更新時刻が変わる親ディレクトリのエントリも破棄する。
+     * ディレクトリの削除・名前変更では配下もまとめて破棄し、OVERFLOWED では全てを破棄する。
+     */
+    void invalidate(const WatchEvent& event)
+    {
+        if (event.type == WatchEvent::OVERFLOWED)
+        {
+            clear();
+            return;
+        }
+        bool tree = event.type != WatchEvent::CREATED && event.type != WatchEvent::MODIFIED && event.is_directory;
+#ifndef __unix__
+        tree = event.type != WatchEvent::CREATED && event.type != WatchEvent::MODIFIED;   // is_directory が得られない
+#endif
+        if (tree)
+            invalidate_tree(event.path);
+        else
+            invalidate(event.path);
+        if (event.type != WatchEvent::MODIFIED)
+            invalidate(event.path.parent_path());
+    }
+
+    void invalidate(const std::vector<WatchEvent>& events)
+    {
+        for (std::size_t i = 0; i < events.size(); ++i)
+            invalidate(events[i]);
+    }
+
+#if defined(__linux__) || !defined(__unix__)
+    /**
+     * @brief DirectoryWatcher::start() へ渡すと、受け取ったイベントでこのキャッシュを無効化するコールバック
+     * 
+     * キャッシュはウォッチャーより長く生存していなければならない。
+     */
+    DirectoryWatcher::Callback invalidator()
+    {
+        return [this](const std::vector<WatchEvent>& events) { invalidate(events); };
+    }
+#endif
+
+    void clear()
+    {
+        for (std::size_t i = 0; i < shards_.size(); ++i)
+        {
+            Shard& shard = shards_[i];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            ++shard.generation;
+            shard.invalidations += shard.entries.size();
+            shard.entries.clear();
+        }
+    }
+
+    std::size_t size() const
+    {
+        std::size_t result = 0;
+        for (std::size_t i = 0; i < shards_.size(); ++i)
+        {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex);
+            result += shards_[i].entries.size();
+        }
+        return result;
+    }
+
+    /** @brief 有効なエントリから返した回数 */
+    uint64_t hits() const
+    {
+        return sum(&Shard::hits);
+    }
+
+    /** @brief stat を行った回数 (未登録または期限切れ) */
+    uint64_t misses() const
+    {
+        return sum(&Shard::misses);
+    }
+
+    /** @brief invalidate() / clear() で破棄したエントリ数 */
+    uint64_t invalidations() const
+    {
+        return sum(&Shard::invalidations);
+    }
+
+    void reset_counters()
+    {
+        for (std::size_t i = 0; i < shards_.size(); ++i)
+        {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex);
+            shards_[i].hits = shards_[i].misses = shards_[i].invalidations = 0;
+        }
+    }
+
+private:
+    struct Entry
+    {
+        FileStatus status[2];           /**< [follow_symlink] */
+        int64_t expires[2];             /**< 有効期限 (steady_clock [ns]) */
+
+        Entry()
+        {
+            expires[0] = expires[1] = 0;
+        }
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<FilePath, Entry> entries;
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t invalidations;
+        uint64_t generation;            /**< invalidate() / clear() のたびに進める (ロックの外で行った stat の登録可否の判定) */
+
+        Shard()
+         :  mutex(), entries(), hits(0), misses(0), invalidations(0), generation(0)
+        {}
+    };
+
+    const int64_t ttl_ns_;
+    const std::size_t shard_capacity_;
+    std::vector<Shard> shards_;
+
+    StatCache(const StatCache&);
+    StatCache& operator=(const StatCache&);
+
+    static int64_t clock()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    Shard& shard_for(const FilePath& path)
+    {
+        // 下位ビットはシャード内のハッシュテーブルが使うため、混ぜてから上位ビットで選ぶ
+        return shards_[((static_cast<uint64_t>(path.hash()) * 0x9E3779B97F4A7C15ULL) >> 32) % shards_.size()];
+    }
+
+    /**
+     * @brief 期限切れのエントリを破棄し、それでも空かない場合はシャードを空にする
+     */
+    void evict(Shard& shard, int64_t now)
+    {
+        for (std::unordered_map<FilePath, Entry>::iterator it = shard.entries.begin(); it != shard.entries.end(); )
+        {
+            if (it->second.expires[0] <= now && it->second.expires[1] <= now)
+                it = shard.entries.erase(it);
+            else
+                ++it;
+        }
+        if (shard.entries.size() >= shard_capacity_)
+            shard.entries.clear();
+    }
+
+    uint64_t sum(uint64_t Shard::*counter) const
+    {
+        uint64_t result = 0;
+        for (std::size_t i = 0; i < shards_.size(); ++i)
+        {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex);
+            result += shards_[i].*counter;
+        }
+        return result;
+    }
+};
+
+inline FileStatus FilePath::status(StatCache& cache) const
+{
+    return cache.status(*this, true);
+}
+
+inline FileStatus FilePath::symlink_status(StatCache& cache) const
+{
+    return cache.status(*this, false);
+}
+
+/**
+ * @struct SnapshotOptions
+ * @brief DirectorySnapshot::capture の設定
+ */
+struct SnapshotOptions
+{
+    unsigned threads;                   /**< ワーカースレッド数 (0 の場合はコア数) */
+    bool reuse_subtrees;                /**< 前回から inode と更新時刻が変わっていないディレクトリは、直下のファイルを stat せず前回のレコードを用いる */
+
+    SnapshotOptions()
+     :  threads(0), reuse_subtrees(false)
+    {}
+};
+
+/**
+ * @struct SnapshotChange
+ * @brief DirectorySnapshot::diff が返す差分
+ */
+struct SnapshotChange
+{
+    enum Type
+    {
+        ADDED = 0,
+        REMOVED,
+        MODIFIED                        /**< 種別以外 (サイズ / 更新時刻 / inode) が変わった */
+    };
+
+    Type type;
+    FilePath path;
+
+    SnapshotChange(Type type, const FilePath& path)
+     :  type(type), path(path)
+    {}
+};
+
+/**
+ * @class DirectorySnapshot
+ * @brief ディレクトリツリーの (名前, inode, サイズ, 更新時刻) を固定長のレコード列と名前のバッファとして保持するスナップショット
+ * 
+ * レコードは幅優先の順に並び、各ディレクトリの子は連続した範囲に名前順で格納されるため、
+ * パスの検索は二分探索、差分はマージで行える。save() で書き出したファイルは load() で
+ * MappedFile としてマップし、コピーせずにそのまま参照する (バイトオーダーは書き出した環境に依存する)。
+ * 
+ * capture() に前回のスナップショットを渡した場合、inode と更新時刻が変わっていないディレクトリは
+ * readdir を省略して前回の一覧を再利用する。ディレクトリの更新時刻は直下のエントリの追加 / 削除 / 名前変更でしか
+ * 変わらないため、ファイルは常に stat し直す。SnapshotOptions::reuse_subtrees を指定した場合はファイルの
+ * レコードも再利用して stat を省略するが、既存のファイルの内容の変更は検出できなくなる。いずれの場合も
+ * サブディレクトリは stat し直して降り、深い階層での追加 / 削除 / 名前変更はそれぞれのディレクトリの更新時刻で検出する。
+ */
+class DirectorySnapshot
+{
+public:
+    static const uint32_t INVALID = 0xFFFFFFFFu;
+
+    /**
+     * @brief 1エントリ分のレコード (ファイルへそのまま書き出すため固定長)
+     */
+    struct Record
+    {
+        uint64_t inode;
+        int64_t size;
+        int64_t mtime;                  /**< 更新時刻 (エポックからのナノ秒) */
+        uint32_t parent;                /**< 親ディレクトリのレコード番号 (ルートは INVALID) */
+        uint32_t name_offset;
+        uint32_t first_child;           /**< 子の先頭のレコード番号 (ディレクトリのみ) */
+        uint32_t child_count;
+        uint16_t name_length;
+        uint8_t type;                   /**< FileStatus::Type */
+        uint8_t reserved;
+        uint32_t padding;
+    };
+
+    DirectorySnapshot()
+     :  root_(), platform_(FilePath::NATIVE), records_(), names_(), mapped_(),
+        record_data_(NULL), record_count_(0), name_data_(NULL), names_size_(0)
+    {}
+
+    DirectorySnapshot(DirectorySnapshot&& other)
+     :  root_(std::move(other.root_)), platform_(other.platform_), records_(std::move(other.records_)), names_(std::move(other.names_)), mapped_(std::move(other.mapped_)),
+        record_data_(other.record_data_), record_count_(other.record_count_), name_data_(other.name_data_), names_size_(other.names_size_)
+    {
+        if (!mapped_.is_open())
+            bind();
+        other.clear();
+    }
+
+    DirectorySnapshot& operator=(DirectorySnapshot&& other)
+    {
+        if (this != &other)
+        {
+            root_         = std::move(other.root_);
+            platform_     = other.platform_;
+            records_      = std::move(other.records_);
+            names_        = std::move(other.names_);
+            mapped_       = std::move(other.mapped_);
+            record_data_  = other.record_data_;
+            record_count_ = other.record_count_;
+            name_data_    = other.name_data_;
+            names_size_   = other.names_size_;
+            if (!mapped_.is_open())
+                bind();
+            other.clear();
+        }
+        return *this;
+    }
+
+    /**
+     * @brief root 配下のスナップショットを作成する (失敗した場合は empty() となる)
+     * 
+     * @param root 対象のディレクトリ
+     * @param previous 前回のスナップショット (変化していないディレクトリの一覧を再利用する。NULL の場合は全て走査する)
+     * @param options 設定
+     * @return DirectorySnapshot 
+     */
+    static DirectorySnapshot capture(const FilePath& root, const DirectorySnapshot* previous = NULL, const SnapshotOptions& options = SnapshotOptions());
+
+    bool empty() const
+    {
+        return record_count_ == 0;
+    }
+
+    /**
+     * @brief ルートを含むレコード数
+     */
+    std::size_t size() const
+    {
+        return record_count_;
+    }
+
+    const Record& operator[](std::size_t index) const
+    {
+        return record_data_[index];
+    }
+
+    const FilePath& root() const
+    {
+        return root_;
+    }
+
+    /**
+     * @brief レコードの名前 (スナップショット内の文字列を指す)
+     */
+    FilePathView name(std::size_t index) const
+    {
+        const Record& record = record_data_[index];
+        return FilePathView(name_data_ + record.name_offset, record.name_length, platform_);
+    }
+
+    /**
+     * @brief レコードのパス (root() からの名前を連結する)
+     */
+    FilePath path(std::size_t index) const
+    {
+        std::vector<uint32_t> chain;
+        for (uint32_t i = static_cast<uint32_t>(index); i != 0 && i != INVALID; i = record_data_[i].parent)
+            chain.push_back(i);
+
+        FilePath result(root_);
+        for (std::size_t i = chain.size(); i > 0; --i)
+        {
+            const Record& record = record_data_[chain[i - 1]];
+            result.append_component(name_data_ + record.name_offset, record.name_length);
+        }
+        return result;
+    }
+
+    /**
+     * @brief path のレコード番号を二分探索で求める
+     * 
+     * @return std::size_t 存在しない場合は INVALID
+     */
+    std::size_t find(const FilePath& path) const
+    {
+        if (empty() || path.platform_ != platform_ || !path.view().starts_with(root_.view()))
+            return INVALID;
+
+        // root_ の後の区切り文字を読み飛ばす (root_ がルートのみの場合は区切り文字を含んでいる)
+        uint32_t index = 0;
+        std::size_t pos = root_.path_.size();
+        if (!root_.empty())
+            ++pos;
+        for (std::size_t length; index != INVALID && path.next_component(pos, length); pos += length + 1)
+            index = find_child(index, path.path_.data() + pos, length);
+        return index;
+    }
+
+    /**
+     * @brief older から newer への差分を求める (どちらもメモリ上のマージのみで、ファイルシステムへはアクセスしない)
+     * 
+     * 追加 / 削除されたディレクトリは、配下のエントリもそれぞれ ADDED / REMOVED として返す。
+     * 
+     * @return std::vector<SnapshotChange> 
+     */
+    static std::vector<SnapshotChange> diff(const DirectorySnapshot& older, const DirectorySnapshot& newer)
+    {
+        std::vector<SnapshotChange> changes;
+        if (older.empty() || newer.empty())
+        {
+            if (!older.empty())
+                older.report(0, SnapshotChange::REMOVED, changes);
+            if (!newer.empty())
+                newer.report(0, SnapshotChange::ADDED, changes);
+            return changes;
+        }
+        diff_children(older, 0, newer, 0, changes);
+        return changes;
+    }
+
+    /**
+     * @brief スナップショットをファイルへ書き出す
+     */
+    bool save(const FilePath& file) const
+    {
+        if (empty())
+            return false;
+        Header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, magic(), sizeof(header.magic));
+        header.version      = VERSION;
+        header.platform     = static_cast<uint32_t>(platform_);
+        header.record_count = record_count_;
+        header.names_size   = names_size_;
+        header.root_size    = root_.path_.size();
+
+        std::ofstream out(file.c_str(), std::ios::binary | std::ios::trunc);
+        const char padding[8] = { 0 };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(root_.path_.data(), static_cast<std::streamsize>(root_.path_.size()));
+        out.write(padding, static_cast<std::streamsize>(padding_of(root_.path_.size())));
+        out.write(reinterpret_cast<const char*>(record_data_), static_cast<std::streamsize>(record_count_ * sizeof(Record)));
+        out.write(name_data_, static_cast<std::streamsize>(names_size_));
+        out.close();
+        return !out.fail();
+    }
+
+    /**
+     * @brief save() で書き出したファイルをマップして読み込む (レコードはコピーしない)
+     * 
+     * 壊れたファイルや細工されたファイルで範囲外を参照しないよう、ヘッダーの各サイズと
+     * 全レコードの名前・子の範囲をここで一度だけ検査し、以降の参照では検査しない。
+     */
+    bool load(const FilePath& file)
+    {
+        clear();
+        MappedFile mapped(file, MappedFile::WILLNEED);
+        if (!mapped.is_open() || mapped.size() < sizeof(Header))
+            return false;
+
+        Header header;
+        std::memcpy(&header, mapped.data(), sizeof(header));
+        if (std::memcmp(header.magic, magic(), sizeof(header.magic)) != 0 || header.version != VERSION || header.platform > FilePath::WINDOWS)
+            return false;
+        // 加算や乗算で桁あふれしないよう、残りのサイズとの比較で検査する
+        const uint64_t size = mapped.size();
+        if (header.root_size > size - sizeof(Header))
+            return false;
+        const uint64_t records_offset = sizeof(Header) + header.root_size + padding_of(static_cast<std::size_t>(header.root_size));
+        if (records_offset > size)
+            return false;
+        const uint64_t rest = size - records_offset;
+        if (header.record_count == 0 || header.record_count >= INVALID || header.record_count > rest / sizeof(Record)
+         || header.names_size != rest - header.record_count * sizeof(Record))
+            return false;
+        const Record* records = reinterpret_cast<const Record*>(mapped.data() + records_offset);
+        if (!valid(records, header.record_count, header.names_size))
+            return false;
+
+        root_.set(mapped.data() + sizeof(Header), static_cast<std::size_t>(header.root_size), static_cast<FilePath::Platform>(header.platform));
+        platform_     = static_cast<FilePath::Platform>(header.platform);
+        record_data_  = records;
+        record_count_ = static_cast<std::size_t>(header.record_count);
+        name_data_    = mapped.data() + records_offset + header.record_count * sizeof(Record);
+        names_size_   = static_cast<std::size_t>(header.names_size);
+        mapped_       = std::move(mapped);
+        return true;
+    }
+
+private:
+    friend class SnapshotBuilder;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t platform;
+        uint64_t record_count;
+        uint64_t names_size;
+        uint64_t root_size;
+    };
+
+    static const uint32_t VERSION = 1;
+
+    static const char* magic()
+    {
+        return "FPSNAP\0";            // 終端の NUL を含めて 8 バイト
+    }
+
+    FilePath root_;
+    FilePath::Platform platform_;
+    std::vector<Record> records_;       /**< capture() で作成した場合のレコード (load() した場合は空) */
+    std::string names_;
+    MappedFile mapped_;                 /**< load() した場合のファイル */
+    const Record* record_data_;
+    std::size_t record_count_;
+    const char* name_data_;
+    std::size_t names_size_;
+
+    static std::size_t padding_of(std::size_t size)
+    {
+        return (8 - size % 8) % 8;
+    }
+
+    /**
+     * @brief 名前と子の範囲が収まり、親は前方・子は後方にある (辿っても循環しない) ことを確かめる
+     */
+    static bool valid(const Record* records, uint64_t count, uint64_t names_size)
+    {
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            const Record& record = records[i];
+            if (static_cast<uint64_t>(record.name_offset) + record.name_length > names_size)
+                return false;
+            if (i != 0 && record.parent >= i)
+                return false;
+            if (record.child_count != 0 && (record.first_child <= i || static_cast<uint64_t>(record.first_child) + record.child_count > count))
+                return false;
+        }
+        return true;
+    }
+
+    void bind()
+    {
+        record_data_  = records_.empty() ? NULL : &records_[0];
+        record_count_ = records_.size();
+        name_data_    = names_.data();
+        names_size_   = names_.size();
+    }
+
+    void clear()
+    {
+        root_ = FilePath();
+        records_.clear();
+        names_.clear();
+        mapped_.close();
+        bind();
+    }
+
+    static int compare(const char* lhs, std::size_t lhs_size, const char* rhs, std::size_t rhs_size)
+    {
+        const int ret = std::memcmp(lhs, rhs, std::min(lhs_size, rhs_size));
+        if (ret != 0)
+            return ret;
+        return (lhs_size < rhs_size) ? -1 : (lhs_size > rhs_size) ? 1 : 0;
+    }
+
+    int compare(uint32_t index, const char* name, std::size_t length) const
+    {
+        const Record& record = record_data_[index];
+        return compare(name_data_ + record.name_offset, record.name_length, name, length);
+    }
+
+    uint32_t find_child(uint32_t parent, const char* name, std::size_t length) const
+    {
+        const Record& record = record_data_[parent];
+        if (record.type != FileStatus::DIRECTORY)
+            return INVALID;
+        uint32_t first = record.first_child;
+        uint32_t last = record.first_child + record.child_count;
+        while (first < last)
+        {
+            const uint32_t middle = first + (last - first) / 2;
+            const int ret = compare(middle, name, length);
+            if (ret == 0)
+                return middle;
+            if (ret < 0)
+                first = middle + 1;
+            else
+                last = middle;
+        }
+        return INVALID;
+    }
+
+    void report(uint32_t index, SnapshotChange::Type type, std::vector<SnapshotChange>& changes) const
+    {
+        if (index != 0)
+            changes.push_back(SnapshotChange(type, path(index)));
+        const Record& record = record_data_[index];
+        if (record.type == FileStatus::DIRECTORY)
+        {
+            for (uint32_t i = 0; i < record.child_count; ++i)
+                report(record.first_child + i, type, changes);
+        }
+    }
+
+    static void diff_children(const DirectorySnapshot& older, uint32_t older_index, const DirectorySnapshot& newer, uint32_t newer_index, std::vector<SnapshotChange>& changes)
+    {
+        const Record& older_parent = older[older_index];
+        const Record& newer_parent = newer[newer_index];
+        uint32_t i = older_parent.first_child, i_last = older_parent.first_child + older_parent.child_count;
+        uint32_t j = newer_parent.first_child, j_last = newer_parent.first_child + newer_parent.child_count;
+        while (i < i_last || j < j_last)
+        {
+            int ret;
+            if (i == i_last)
+                ret = 1;
+            else if (j == j_last)
+                ret = -1;
+            else
+                ret = compare(older.name_data_ + older[i].name_offset, older[i].name_length, newer.name_data_ + newer[j].name_offset, newer[j].name_length);
+
+            if (ret < 0)
+            {
+                older.report(i++, SnapshotChange::REMOVED, changes);
+                continue;
+            }
+            if (ret > 0)
+            {
+                newer.report(j++, SnapshotChange::ADDED, changes);
+                continue;
+            }
+
+            const Record& lhs = older[i];
+            const Record& rhs = newer[j];
+            if (lhs.type != rhs.type)
+            {
+                older.report(i, SnapshotChange::REMOVED, changes);
+                newer.report(j, SnapshotChange::ADDED, changes);
+            }
+            else if (lhs.type == FileStatus::DIRECTORY)
+            {
+                diff_children(older, i, newer, j, changes);
+            }
+            else if (lhs.size != rhs.size || lhs.mtime != rhs.mtime || lhs.inode != rhs.inode)
+            {
+                changes.push_back(SnapshotChange(SnapshotChange::MODIFIED, newer.path(j)));
+            }
+            ++i;
+            ++j;
+        }
+    }
+
+    DirectorySnapshot(const DirectorySnapshot&);
+    DirectorySnapshot& operator=(const DirectorySnapshot&);
+};
+
+/**
+ * @class SnapshotBuilder
+ * @brief DirectorySnapshot::capture の実装。ディレクトリ1つの走査を1タスクとして WorkStealingPool で並列に行い、
+ *        終了後に幅優先の順でレコードへ並べ直す
+ */
+class SnapshotBuilder
+{
+public:
+    static DirectorySnapshot capture(const FilePath& root, const DirectorySnapshot* previous, const SnapshotOptions& options)
+    {
+        DirectorySnapshot result;
+        std::shared_ptr<DirectoryHandle> handle(new DirectoryHandle(root));
+        if (!handle->is_open())
+            return result;
+
+        SnapshotBuilder builder(previous, options);
+        builder.root_.status = handle->status();
+        if (previous != NULL && !previous->empty() && previous->root() == root)
+            builder.root_.previous = 0;
+        builder.pool_.spawn(0, [&builder, handle](std::size_t worker)
+        {
+            builder.scan(worker, &builder.root_, handle);
+        });
+        builder.pool_.run();
+
+        result.root_     = root;
+        result.platform_ = root.platform_;
+        builder.flatten(result);
+        result.bind();
+        return result;
+    }
+
+private:
+    typedef DirectorySnapshot::Record Record;
+
+    struct Node
+    {
+        std::string name;
+        FileStatus status;
+        uint32_t previous;                          /**< 前回のスナップショットでのレコード番号 */
+        bool reused;                                /**< 直下のファイルのレコードを前回のスナップショットから複製する (children はディレクトリのみ) */
+        std::vector<std::unique_ptr<Node> > children;
+
+        Node()
+         :  name(), status(), previous(DirectorySnapshot::INVALID), reused(false), children()
+        {}
+    };
+
+    const DirectorySnapshot* previous_;
+    const SnapshotOptions options_;
+    WorkStealingPool pool_;
+    Node root_;
+
+    SnapshotBuilder(const DirectorySnapshot* previous, const SnapshotOptions& options)
+     :  previous_(previous), options_(options), pool_(options.threads), root_()
+    {}
+
+    bool unchanged(const Node& node) const
+    {
+        if (node.previous == DirectorySnapshot::INVALID)
+            return false;
+        const Record& record = (*previous_)[node.previous];
+        return record.type == FileStatus::DIRECTORY && record.inode == node.status.inode() && record.mtime == node.status.mtime();
+    }
+
+    void add_child(Node* node, const DirectoryHandle& handle, const std::string& name)
+    {
+        std::unique_ptr<Node> child(new Node());
+        child->status = handle.symlink_status(name.c_str());
+        if (!child->status.exists())
+            return;
+        child->name = name;
+        node->children.push_back(std::move(child));
+    }
+
+    void scan(std::size_t worker, Node* node, const std::shared_ptr<DirectoryHandle>& handle)
+    {
+        if (!handle->is_open())
+            return;
+
+        const bool same = unchanged(*node);
+        if (same && options_.reuse_subtrees)
+        {
+            // ファイルは前回のレコードを用い、ディレクトリのみ stat し直して配下の変更を確かめる
+            node->reused = true;
+            const Record& record = (*previous_)[node->previous];
+            for (uint32_t i = 0; i < record.child_count; ++i)
+            {
+                if ((*previous_)[record.first_child + i].type == FileStatus::DIRECTORY)
+                    add_child(node, *handle, previous_->name(record.first_child + i).to_str());
+            }
+        }
+        else if (same)
+        {
+            // 直下の一覧は前回と同じため readdir を省略し、属性のみを取得し直す
+            const Record& record = (*previous_)[node->previous];
+            for (uint32_t i = 0; i < record.child_count; ++i)
+                add_child(node, *handle, previous_->name(record.first_child + i).to_str());
+        }
+        else
+        {
+            for (DirectoryIterator it(*handle), last; it != last; ++it)
+                add_child(node, *handle, it->filename());
+            std::sort(node->children.begin(), node->children.end(), [](const std::unique_ptr<Node>& lhs, const std::unique_ptr<Node>& rhs)
+            {
+                return lhs->name < rhs->name;
+            });
+        }
+
+        for (std::size_t i = 0; i < node->children.size(); ++i)
+        {
+            Node* child = node->children[i].get();
+            if (child->status.type() != FileStatus::DIRECTORY)
+                continue;
+            if (node->previous != DirectorySnapshot::INVALID)
+                child->previous = previous_->find_child(node->previous, child->name.data(), child->name.size());
+            std::shared_ptr<DirectoryHandle> parent(handle);
+            pool_.spawn(worker, [this, child, parent](std::size_t current) mutable
+            {
+                std::shared_ptr<DirectoryHandle> directory(new DirectoryHandle(parent->open_directory(child->name.c_str())));
+                parent.reset();
+                if (!directory->is_open())
+                    *directory = DirectoryHandle(directory->path());
+                scan(current, child, directory);
+            });
+        }
+    }
+
+    /**
+     * 走査結果 (Node) または前回のスナップショットのレコードを幅優先で並べる
+     */
+    struct Pending
+    {
+        const Node* node;
+        uint32_t index;
+    };
+
+    static Record make_record(const FileStatus& status, uint32_t parent)
+    {
+        Record record;
+        std::memset(&record, 0, sizeof(record));
+        record.inode  = status.inode();
+        record.size   = status.size();
+        record.mtime  = status.mtime();
+        record.parent = parent;
+        record.type   = static_cast<uint8_t>(status.type());
+        return record;
+    }
+
+    void flatten(DirectorySnapshot& result) const
+    {
+        std::vector<Record>& records = result.records_;
+        std::string& names = result.names_;
+        records.push_back(make_record(root_.status, DirectorySnapshot::INVALID));
+
+        std::deque<Pending> queue;
+        Pending first = { &root_, 0 };
+        queue.push_back(first);
+        while (!queue.empty())
+        {
+            const Pending pending = queue.front();
+            queue.pop_front();
+
+            const Node& node = *pending.node;
+            const uint32_t first_child = static_cast<uint32_t>(records.size());
+            if (!node.reused)
+            {
+                for (std::size_t i = 0; i < node.children.size(); ++i)
+                    push_child(*node.children[i], pending.index, records, names, queue);
+            }
+            else
+            {
+                // 前回のファイルのレコードと stat し直したディレクトリ (どちらも名前順) を併合する。
+                // 存在しなくなったディレクトリは add_child() の時点で除かれている
+                const Record& parent = (*previous_)[node.previous];
+                std::size_t directory = 0;
+                for (uint32_t i = 0; i < parent.child_count; ++i)
+                {
+                    const uint32_t source = parent.first_child + i;
+                    const FilePathView name = previous_->name(source);
+                    if ((*previous_)[source].type == FileStatus::DIRECTORY)
+                    {
+                        if (directory < node.children.size() && node.children[directory]->name.compare(0, std::string::npos, name.data(), name.size()) == 0)
+                            push_child(*node.children[directory++], pending.index, records, names, queue);
+                        continue;
+                    }
+                    Record record = (*previous_)[source];
+                    record.parent = pending.index;
+                    record.first_child = record.child_count = 0;
+                    append_name(record, names, name.data(), name.size());
+                    records.push_back(record);
+                }
+            }
+            records[pending.index].first_child = first_child;
+            records[pending.index].child_count = static_cast<uint32_t>(records.size() - first_child);
+        }
+    }
+
+    static void push_child(const Node& child, uint32_t parent, std::vector<Record>& records, std::string& names, std::deque<Pending>& queue)
+    {
+        Record record = make_record(child.status, parent);
+        append_name(record, names, child.name.data(), child.name.size());
+        records.push_back(record);
+        if (record.type == FileStatus::DIRECTORY)
+        {
+            Pending next = { &child, static_cast<uint32_t>(records.size() - 1) };
+            queue.push_back(next);
+        }
+    }
+
+    static void append_name(Record& record, std::string& names, const char* data, std::size_t size)
+    {
+        record.name_offset = static_cast<uint32_t>(names.size());
+        record.name_length = static_cast<uint16_t>(size);
+        names.append(data, size);
+    }
+
+    SnapshotBuilder(const SnapshotBuilder&);
+    SnapshotBuilder& operator=(const SnapshotBuilder&);
+};
+
+inline DirectorySnapshot DirectorySnapshot::capture(const FilePath& root, const DirectorySnapshot* previous, const SnapshotOptions& options)
+{
+    return SnapshotBuilder::capture(root, previous, options);
+}
+
+#ifdef FILE_PATH_HAS_IO_URING
+/**
+ * @class StatxRing
+ * @brief FilePath::status_batch が用いる、statx 専用の最小限の io_uring ラッパー
+ * 
+ * liburing に依存しないよう、io_uring_setup / io_uring_enter を直接呼び出す。
+ */
+class StatxRing
+{
+public:
+    explicit StatxRing(unsigned entries = 256)
+     :  fd_(-1), sq_ring_(MAP_FAILED), cq_ring_(MAP_FAILED), sqes_(MAP_FAILED), sq_ring_size_(0), cq_ring_size_(0), sqes_size_(0)
+    {
+        struct io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0)
+            return;
+
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap)
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+
+        sq_ring_ = mmap(NULL, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if (sq_ring_ == MAP_FAILED)
+        {
+            close();
+            return;
+        }
+        cq_ring_ = single_mmap ? sq_ring_ : mmap(NULL, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED)
+        {
+            close();
+            return;
+        }
+        sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+        sqes_ = mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sqes_ == MAP_FAILED)
+        {
+            close();
+            return;
+        }
 
-        for (size_t i = 0; i < other.path_.size(); ++i)
-            result.path_.push_back(other.path_[i]);
+        char* sq = static_cast<char*>(sq_ring_);
+        char* cq = static_cast<char*>(cq_ring_);
+        sq_tail_  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask_  = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cq_head_  = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_  = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_  = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_     = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+        depth_    = params.sq_entries;
+        buffers_.resize(depth_);
+        slots_.resize(depth_);
+    }
 
-        return result;
+    ~StatxRing()
+    {
+        close();
     }
 
-    friend std::ostream& operator<<(std::ostream& os, const FilePath& path)
+    bool is_open() const
     {
-        os << path.to_str();
-        return os;
+        return fd_ >= 0;
     }
 
     /**
-     * @brief 
+     * @brief 全てのパスについて statx を投入し、完了を待って result へ格納する
      * 
-     * @return int64_t 
+     * 失敗した場合も、カーネルが処理中の statx (buffers_ と paths を参照する) が全て完了するのを待ってから戻る。
+     * 
+     * @return bool io_uring の呼び出しが失敗した, またはカーネルが statx に対応していない場合は false (result は不完全)
      */
-    int64_t file_size() const 
+    bool run(const std::vector<FilePath>& paths, bool follow_symlink, std::vector<FileStatus>& result)
     {
-#ifdef __unix__
-        struct stat st;
-        if(!is_file() || stat(to_str().c_str(), &st) != 0)
+        std::vector<unsigned> free_slots(depth_);
+        for (unsigned i = 0; i < depth_; ++i)
+            free_slots[i] = depth_ - 1 - i;
+
+        std::size_t next = 0;
+        unsigned pending = 0;           // リングへ書き込んだが、カーネルがまだ取り込んでいない SQE
+        std::size_t in_flight = 0;      // カーネルが取り込み、完了を待っている SQE
+        bool ok = true;
+        while (ok && (next < paths.size() || pending > 0 || in_flight > 0))
         {
-            return -1;
+            unsigned tail = *sq_tail_;
+            while (next < paths.size() && !free_slots.empty())
+            {
+                const unsigned slot = free_slots.back();
+                free_slots.pop_back();
+                slots_[slot] = next;
+
+                struct io_uring_sqe& sqe = static_cast<struct io_uring_sqe*>(sqes_)[tail & sq_mask_];
+                std::memset(&sqe, 0, sizeof(sqe));
+                sqe.opcode      = IORING_OP_STATX;
+                sqe.fd          = AT_FDCWD;
+                sqe.addr        = reinterpret_cast<uintptr_t>(paths[next].c_str());
+                sqe.len         = STATX_BASIC_STATS;
+                sqe.off         = reinterpret_cast<uintptr_t>(&buffers_[slot]);
+                sqe.statx_flags = follow_symlink ? 0 : AT_SYMLINK_NOFOLLOW;
+                sqe.user_data   = slot;
+                sq_array_[tail & sq_mask_] = tail & sq_mask_;
+                ++tail;
+                ++next;
+                ++pending;
+            }
+            __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+            // 一部しか取り込まれなかった場合、カーネルは待機せずに戻るため、残りは次の呼び出しで投入し直す
+            int ret;
+            {
+                FILE_PATH_TRACE(STATX_BATCH);
+                ret = static_cast<int>(syscall(__NR_io_uring_enter, fd_, pending, 1, IORING_ENTER_GETEVENTS, NULL, 0));
+            }
+            if (ret >= 0)
+            {
+                pending -= static_cast<unsigned>(ret);
+                in_flight += static_cast<std::size_t>(ret);
+                if (ret == 0 && pending > 0 && in_flight == 0)
+                    ok = false;
+            }
+            else if (errno == EAGAIN || errno == EBUSY)
+            {
+                ok = in_flight > 0;     // 完了を回収すれば空きができる。処理中のものが無ければ進めない
+            }
+            else if (errno != EINTR)
+            {
+                ok = false;
+            }
+            if (!reap(result, free_slots, in_flight))
+                ok = false;
         }
-        return st.st_size;
-#else
-        HANDLE handle = CreateFileA(to_str().c_str(), GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-        if (handle == INVALID_HANDLE_VALUE) 
+
+        if (!ok)
         {
-            return -1;
+            // 取り込まれていない SQE は取り消し、処理中の statx は完了を待つ
+            __atomic_store_n(sq_tail_, *sq_tail_ - pending, __ATOMIC_RELEASE);
+            while (in_flight > 0)
+            {
+                const int ret = static_cast<int>(syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0));
+                if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                    break;
+                reap(result, free_slots, in_flight);
+            }
         }
-        LARGE_INTEGER size;
-        if (!GetFileSizeEx(handle, &size)) 
+        return ok;
+    }
+
+private:
+    int fd_;
+    void* sq_ring_;
+    void* cq_ring_;
+    void* sqes_;
+    std::size_t sq_ring_size_;
+    std::size_t cq_ring_size_;
+    std::size_t sqes_size_;
+    unsigned* sq_tail_;
+    unsigned sq_mask_;
+    unsigned* sq_array_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    struct io_uring_cqe* cqes_;
+    unsigned depth_;
+    std::vector<struct statx> buffers_;     /**< スロットごとの statx の出力先 */
+    std::vector<std::size_t> slots_;        /**< スロットが処理中のパスの添字 */
+
+    StatxRing(const StatxRing&);
+    StatxRing& operator=(const StatxRing&);
+
+    /**
+     * @brief 完了した CQE を回収して result へ格納する
+     * 
+     * @return bool カーネルが statx に対応していない (-EINVAL) 完了があった場合は false
+     */
+    bool reap(std::vector<FileStatus>& result, std::vector<unsigned>& free_slots, std::size_t& in_flight)
+    {
+        bool supported = true;
+        unsigned head = *cq_head_;
+        const unsigned cq_tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != cq_tail; ++head)
         {
-            CloseHandle(handle);
-            return -1;
+            const struct io_uring_cqe& cqe = cqes_[head & cq_mask_];
+            const unsigned slot = static_cast<unsigned>(cqe.user_data);
+            if (cqe.res == -EINVAL)
+                supported = false;      // IORING_OP_STATX 未対応のカーネル
+            else if (cqe.res < 0)
+                result[slots_[slot]] = FileStatus::from_errno(-cqe.res);
+            else
+                result[slots_[slot]] = FileStatus(buffers_[slot]);
+            free_slots.push_back(slot);
+            --in_flight;
         }
-        return size.QuadPart;
-#endif
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        return supported;
     }
 
-    bool empty() const 
-    { 
-        return path_.empty(); 
+    void close()
+    {
+        if (sqes_ != MAP_FAILED)
+            munmap(sqes_, sqes_size_);
+        if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_)
+            munmap(cq_ring_, cq_ring_size_);
+        if (sq_ring_ != MAP_FAILED)
+            munmap(sq_ring_, sq_ring_size_);
+        if (fd_ >= 0)
+            ::close(fd_);
+        sqes_ = cq_ring_ = sq_ring_ = MAP_FAILED;
+        fd_ = -1;
     }
+};
+#endif
 
-    bool is_absolute() const 
-    { 
-        return is_absolute_; 
-    }
+inline std::vector<FileStatus> FilePath::status_batch(const std::vector<FilePath>& paths, bool follow_symlink)
+{
+    std::vector<FileStatus> result(paths.size());
+    if (paths.empty())
+        return result;
 
-    bool is_directory() const
+#ifdef FILE_PATH_HAS_IO_URING
     {
-#ifdef __unix__
-        struct stat sb;
-        if (stat(to_str().c_str(), &sb))
-            return false;
-        return S_ISDIR(sb.st_mode);
-#else
-        DWORD attr = GetFileAttributesA(to_str().c_str());
-        return (attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_DIRECTORY) != 0);
+        StatxRing ring;
+        if (ring.is_open() && ring.run(paths, follow_symlink, result))
+            return result;
+    }
 #endif
+
+    // 1タスクあたりのパス数。stat 1回よりタスクの受け渡しの方が重くならない程度にまとめる
+    const std::size_t chunk = 256;
+    WorkStealingPool pool;
+    for (std::size_t first = 0; first < paths.size(); first += chunk)
+    {
+        const std::size_t last = std::min(first + chunk, paths.size());
+        pool.spawn(first / chunk, [&paths, &result, first, last, follow_symlink](std::size_t)
+        {
+            for (std::size_t i = first; i < last; ++i)
+                result[i] = paths[i].query_status(follow_symlink);
+        });
     }
+    pool.run();
+    return result;
+}
 
-    bool is_file() const
+/**
+ * @struct AsyncOptions
+ * @brief AsyncFileSystem の動作設定
+ */
+struct AsyncOptions
+{
+    unsigned threads;               /**< ワーカー数 (0 の場合はコア数) */
+    std::size_t max_queue_depth;    /**< 待機できる要求数の上限。超えると投入したスレッドが空きを待つ */
+    unsigned max_batch;             /**< 連続する status 要求を1回の io_uring 投入にまとめる上限 */
+
+    AsyncOptions()
+     :  threads(0), max_queue_depth(4096), max_batch(64)
+    {}
+};
+
+/**
+ * @class AsyncFileSystem
+ * @brief ファイル操作を専用のワーカースレッドで実行し、std::future または完了コールバックで結果を返す
+ * 
+ * 要求は上限付きのキューへ積まれ、ワーカーが先頭から取り出して実行する。
+ * Linux ではキュー上で連続する status 要求を最大 max_batch 件ずつまとめ、ワーカーごとに保持する io_uring で処理する。
+ * io_uring が使えない環境や他のプラットフォームでは、ワーカー上で通常のシステムコールを呼び出す。
+ * コールバックはワーカースレッド上で呼び出されるため、長時間ブロックしたり例外を送出したりしてはならない。
+ * デストラクタはキューに残った要求を全て処理してからワーカーを終了させる。
+ */
+class AsyncFileSystem
+{
+public:
+    typedef std::function<void(const FileStatus& status)> StatusCallback;
+    typedef std::function<void(const std::error_code& ec)> CompletionCallback;
+    typedef std::function<void(std::vector<FilePath>& entries, const std::error_code& ec)> ListCallback;
+
+    explicit AsyncFileSystem(const AsyncOptions& options = AsyncOptions())
+     :  max_queue_depth_(options.max_queue_depth == 0 ? 1 : options.max_queue_depth),
+        max_batch_(options.max_batch == 0 ? 1 : options.max_batch),
+        mutex_(), not_empty_(), not_full_(), queue_(), stopping_(false), threads_()
     {
-#ifdef __unix__
-        struct stat sb;
-        if (stat(to_str().c_str(), &sb))
-            return false;
-        return S_ISREG(sb.st_mode);
-#else
-        DWORD attr = GetFileAttributesA(to_str().c_str());
-        return (attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_DIRECTORY) == 0);
-#endif
+        const unsigned count = (options.threads == 0) ? WorkStealingPool::default_concurrency() : options.threads;
+        for (unsigned i = 0; i < count; ++i)
+            threads_.push_back(std::thread(&AsyncFileSystem::work, this));
     }
 
-    FilePath make_absolute() const
+    ~AsyncFileSystem()
     {
-#ifdef __unix__
-        char tmp[PATH_MAX];
-        if (realpath(to_str().c_str(), tmp) == NULL)
-        {
-            std::stringstream ss;
-            ss << "Internal error in " << __func__ << " : " << errno;
-            throw std::runtime_error(ss.str());
-        }
-        return FilePath(tmp);
-#else
-        std::string tmp(MAX_PATH, '\0');
-        DWORD length = GetFullPathNameA(to_str().c_str(), MAX_PATH, &tmp[0], NULL);
-        if (length == 0)
         {
-            std::stringstream ss;
-            ss << "Internal error in " << __func__ << ":" << GetLastError();
-            throw std::runtime_error(ss.str());
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
         }
-        return FilePath(tmp.substr(0, length));
-#endif
+        not_empty_.notify_all();
+        for (std::size_t i = 0; i < threads_.size(); ++i)
+            threads_[i].join();
     }
 
-    bool exists() const
+    /**
+     * @brief プロセス全体で共有する既定のインスタンス (FilePath::async_status() 等が用いる)
+     */
+    static AsyncFileSystem& instance()
     {
-#ifdef __unix__
-        struct stat sb;
-        return stat(to_str().c_str(), &sb) == 0;
-#else
-        return GetFileAttributesA(to_str().c_str()) != INVALID_FILE_ATTRIBUTES;
-#endif
+        static AsyncFileSystem shared;
+        return shared;
     }
 
-    std::string to_str(Platform platform = NATIVE) const
+    /**
+     * @brief 属性を取得し、完了時に callback を呼び出す (失敗した場合は FileStatus にエラーが格納される)
+     */
+    void status(const FilePath& path, bool follow_symlink, const StatusCallback& callback)
     {
-        std::stringstream ss;
+        Request request;
+        request.is_status = true;
+        request.follow_symlink = follow_symlink;
+        request.path = path;
+        request.on_status = callback;
+        submit(request);
+    }
 
-        if (is_absolute_)
-        {
-            if (platform_ == UNIX)
-                ss << "/";
-        }
+    std::future<FileStatus> status(const FilePath& path, bool follow_symlink = true)
+    {
+        std::shared_ptr<std::promise<FileStatus> > promise(new std::promise<FileStatus>());
+        status(path, follow_symlink, [promise](const FileStatus& status) { promise->set_value(status); });
+        return promise->get_future();
+    }
 
-        for(const auto& p : path_)
+    /**
+     * @brief ファイル (または空のディレクトリ) を削除し、完了時に callback を呼び出す
+     */
+    void remove(const FilePath& path, const CompletionCallback& callback)
+    {
+        submit([path, callback]()
         {
-            if(platform == UNIX)
-                ss << p << '/';
-            else
-                ss << p << '\\';
-        }
-
-        std::string result = ss.str();
-        result.pop_back();
-        return result;
+            std::error_code ec;
+            path.remove_file(ec);
+            callback(ec);
+        });
     }
 
-    std::wstring to_wstr(const Platform& platform = NATIVE) const
+    std::future<std::error_code> remove(const FilePath& path)
     {
-#ifdef __unix__
-        return std::wstring();
-#else
-        std::string tmp = to_str(platform);
-        int size = MultiByteToWideChar(CP_UTF8, 0, &tmp[0], tmp.size(), NULL, 0);
-        std::wstring result(size, 0);
-        MultiByteToWideChar(CP_UTF8, 0, &tmp[0], tmp.size(), &result[0], size);
-        return result;
-#endif
-
+        std::shared_ptr<std::promise<std::error_code> > promise(new std::promise<std::error_code>());
+        remove(path, [promise](const std::error_code& ec) { promise->set_value(ec); });
+        return promise->get_future();
     }
 
     /**
-     * @brief 
-     * 
-     * @param path 
-     * @return std::vector<FilePath> 
+     * @brief ディレクトリ直下のエントリを列挙し、完了時に callback を呼び出す
      */
-    static std::vector<FilePath> directory_iterator(const FilePath& path)
+    void list(const FilePath& path, const ListCallback& callback)
     {
-        if(!path.is_directory())
-            return {};
-        auto result = std::vector<FilePath>();
-#ifdef __unix__
-        DIR* dir = opendir(path.to_str().c_str());
-        if(dir == NULL)
-            return {};
-        struct dirent* dp;
-        while ((dp = readdir(dir)) != NULL)
-        {
-            result.push_back(path / dp->d_name);
-        }
-        closedir(dir);
-#else
-        WIN32_FIND_DATAA win32fd;
-        HANDLE handle = FindFirstFileA((path / "*").to_str().c_str() , &win32fd);
-        if (handle == INVALID_HANDLE_VALUE) 
-        {
-            FindClose(handle);
-            return {};
-        }
-        do 
+        submit([path, callback]()
         {
-            std::string file(win32fd.cFileName);
-            result.push_back(path / file);
-        } while (FindNextFileA(handle, &win32fd));
-        FindClose(handle);
-#endif
-        return result;
+            std::error_code ec;
+            std::vector<FilePath> entries;
+            for (DirectoryIterator it(path, ec), last; it != last; ++it)
+                entries.push_back(it->path());
+            callback(entries, ec);
+        });
     }
 
     /**
-     * @brief 対象ファイルの拡張子を取得する
-     * 
-     * @return std::string 
+     * @return std::future<std::vector<FilePath> > ディレクトリを開けなかった場合、get() は std::system_error を送出する
      */
-    std::string extension() const
+    std::future<std::vector<FilePath> > list(const FilePath& path)
     {
-        if(!is_directory())
-            return "";
-        const std::string name = filename();
-        size_t pos = name.find_last_of('.');
-        if (pos == std::string::npos)
-            return "";
-        return name.substr(pos + 1);
+        std::shared_ptr<std::promise<std::vector<FilePath> > > promise(new std::promise<std::vector<FilePath> >());
+        list(path, [promise, path](std::vector<FilePath>& entries, const std::error_code& ec)
+        {
+            if (ec)
+                promise->set_exception(std::make_exception_ptr(std::system_error(ec, "failed to list " + path.to_str())));
+            else
+                promise->set_value(std::move(entries));
+        });
+        return promise->get_future();
     }
 
-    std::string filename() const
+    /**
+     * @brief FilePath::copy_file() で複製し、完了時に callback を呼び出す
+     */
+    void copy(const FilePath& from, const FilePath& to, bool overwrite, const CompletionCallback& callback)
     {
-        if (empty())
-            return "";
-        return path_.back();
+        submit([from, to, overwrite, callback]()
+        {
+            std::error_code ec;
+            from.copy_file(to, overwrite, ec);
+            callback(ec);
+        });
     }
 
-    FilePath parent_path() const
+    std::future<std::error_code> copy(const FilePath& from, const FilePath& to, bool overwrite = false)
     {
-        FilePath result = *this;
-        if(!result.empty() && result.path_.back() != "." && result.path_.back() != "..")
-            result.path_.pop_back();
-        else
-            result.path_.push_back("..");
+        std::shared_ptr<std::promise<std::error_code> > promise(new std::promise<std::error_code>());
+        copy(from, to, overwrite, [promise](const std::error_code& ec) { promise->set_value(ec); });
+        return promise->get_future();
+    }
 
-        if(is_absolute_)
-        {
-            return result.make_absolute();
-        }
-        return result;
+    /**
+     * @brief キューで実行を待っている要求の数 (実行中のものは含まない)
+     */
+    std::size_t queue_depth() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.size();
     }
 
-    bool remove_file() const
+    std::size_t max_queue_depth() const
     {
-#ifdef __unix__
-        return std::remove(to_str().c_str()) == 0;
-#else
-        return DeleteFileA(to_str().c_str()) != 0;
-#endif
+        return max_queue_depth_;
     }
 
-    bool resize_file(size_t target_length)
+    /**
+     * @brief ワーカー数 (同時に実行される要求数の上限)
+     */
+    unsigned concurrency() const
     {
-#ifdef __unix__
-        return truncate(to_str().c_str(), (off_t)target_length) == 0;
-#else
-        HANDLE handle = CreateFileA(to_str().c_str(), GENERIC_WRITE, 0, nullptr, 0, FILE_ATTRIBUTE_NORMAL, nullptr);
-        if (handle == INVALID_HANDLE_VALUE)
-            return false;
-        LARGE_INTEGER size;
-        size.QuadPart = (LONGLONG)target_length;
-        if (SetFilePointerEx(handle, size, NULL, FILE_BEGIN) == 0)
-        {
-            CloseHandle(handle);
-            return false;
-        }
-        if (SetEndOfFile(handle) == 0)
-        {
-            CloseHandle(handle);
-            return false;
-        }
-        CloseHandle(handle);
-        return true;
-#endif
+        return static_cast<unsigned>(threads_.size());
     }
 
-    static FilePath current_path()
+private:
+    struct Request
     {
-#ifdef __unix__
-        char tmp[PATH_MAX];
-        if (getcwd(tmp, PATH_MAX) == NULL)
-        {
-            std::stringstream ss;
-            ss << "Internal error in current_path(): " << errno;
-            throw std::runtime_error(ss.str());
-        }
-        return FilePath(tmp);
-#else
-        char tmp[MAX_PATH];
-        if (GetCurrentDirectoryA(MAX_PATH, tmp) == NULL)
-        {
-            std::stringstream ss;
-            ss << "Internal error in current_path(): " << GetLastError();
-            throw std::runtime_error(ss.str());
-        }
+        bool is_status;
+        bool follow_symlink;
         FilePath path;
-        path.set(tmp);
-        return path;
-#endif
-    }
+        StatusCallback on_status;
+        std::function<void()> task;
 
-    static bool create_directory(const FilePath &path)
+        Request()
+         :  is_status(false), follow_symlink(true), path(), on_status(), task()
+        {}
+    };
+
+    const std::size_t max_queue_depth_;
+    const unsigned max_batch_;
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<Request> queue_;
+    bool stopping_;
+    std::vector<std::thread> threads_;
+
+    AsyncFileSystem(const AsyncFileSystem&);
+    AsyncFileSystem& operator=(const AsyncFileSystem&);
+
+    void submit(const std::function<void()>& task)
     {
-#ifdef __unix__
-        return mkdir(path.to_str().c_str(), S_IRWXU) == 0;
-#else
-        return CreateDirectoryA(path.to_str().c_str(), NULL) != 0;
-#endif
+        Request request;
+        request.task = task;
+        submit(request);
     }
 
-    /**
-     * @fn application_path
-     * @brief 実行ファイルの絶対パスを取得するメソッド
-     * 
-     * @return FilePath 実行ファイルの絶対パス
-     */
-    static FilePath application_path()
+    void submit(Request& request)
     {
-#ifdef __unix__
-        char tmp[PATH_MAX];
-        if (readlink("/proc/self/exe", tmp, sizeof(tmp)-1) == -1)
         {
-            std::stringstream ss;
-            ss << "Internal error in " << __func__ << " : " << errno;
-            throw std::runtime_error(ss.str());
+            std::unique_lock<std::mutex> lock(mutex_);
+            // ワーカー自身 (コールバック内) からの投入は待たせると全ワーカーが停止し得るため、上限を超えても積む
+            if (!is_worker())
+                not_full_.wait(lock, [this]() { return queue_.size() < max_queue_depth_; });
+            queue_.push_back(std::move(request));
         }
-        return FilePath(tmp);
-#else
-        char tmp[MAX_PATH];
-        GetModuleFileNameA(NULL, tmp, MAX_PATH);
-        return FilePath(tmp);
-#endif      
+        not_empty_.notify_one();
     }
 
-private:
-    std::vector<std::string> path_;     /**< */
-    bool is_absolute_;                  /**< */
-    Platform platform_;
-
-    static std::vector<std::string> split(const std::string& origin, const std::string &delim)
+    bool is_worker() const
     {
-        std::vector<std::string> result;
-        std::size_t last_pos = 0;
-        std::size_t find_pos = origin.find_first_of(delim, last_pos);
-
-        while (last_pos != std::string::npos)
+        const std::thread::id self = std::this_thread::get_id();
+        for (std::size_t i = 0; i < threads_.size(); ++i)
         {
-            if (find_pos != last_pos)
-                result.push_back(origin.substr(last_pos, find_pos - last_pos));
-            last_pos = find_pos;
-            if (last_pos == std::string::npos || last_pos == origin.size()-1)
-                break;
-            last_pos++;
-            find_pos = origin.find_first_of(delim, last_pos);
+            if (threads_[i].get_id() == self)
+                return true;
         }
-
-        return result;
+        return false;
     }
 
-    void set(const std::string& path_str, Platform platform = NATIVE)
+    void work()
     {
-        platform_ = platform;
-        if (platform == WINDOWS)
+#ifdef FILE_PATH_HAS_IO_URING
+        std::unique_ptr<StatxRing> ring(new StatxRing(max_batch_));
+        if (!ring->is_open())
+            ring.reset();
+#endif
+        std::vector<Request> batch;
+        std::vector<FilePath> paths;
+        std::vector<FileStatus> result;
+        for (;;)
         {
-            std::string tmp = path_str;
-
-            if (tmp.size() >= 3 && (static_cast<u_char>(tmp[0]) < 0x80) && std::isalpha(tmp[0]) && tmp[1] == ':' && (tmp[2] == '\\' || tmp[2] == '/'))
             {
-                path_ = {tmp.substr(0, 2)};
-                tmp.erase(0, 3);
-                is_absolute_ = true;
+                std::unique_lock<std::mutex> lock(mutex_);
+                not_empty_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+                if (queue_.empty())
+                    return;
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+                while (batch.front().is_status && batch.size() < max_batch_ && !queue_.empty()
+                    && queue_.front().is_status && queue_.front().follow_symlink == batch.front().follow_symlink)
+                {
+                    batch.push_back(std::move(queue_.front()));
+                    queue_.pop_front();
+                }
             }
-            else
+            not_full_.notify_all();
+
+            if (!batch.front().is_status)
             {
-                path_ = {};
-                is_absolute_ = false;
+                batch.front().task();
+                batch.clear();
+                continue;
             }
 
-            std::vector<std::string> splited = split(tmp, "/\\");
-            path_.insert(std::end(path_), std::begin(splited), std::end(splited));
-        }
-        else
-        {
-            path_ = split(path_str, "/");
-            is_absolute_ = !path_str.empty() && path_str[0] == '/';
+            const bool follow_symlink = batch.front().follow_symlink;
+            for (std::size_t i = 0; i < batch.size(); ++i)
+                paths.push_back(std::move(batch[i].path));
+            result.assign(paths.size(), FileStatus());
+#ifdef FILE_PATH_HAS_IO_URING
+            if (ring && !ring->run(paths, follow_symlink, result))
+                ring.reset();       // 以降はこのワーカーでは io_uring を使わない
+            if (!ring)
+#endif
+            {
+                for (std::size_t i = 0; i < paths.size(); ++i)
+                    result[i] = paths[i].query_status(follow_symlink);
+            }
+            for (std::size_t i = 0; i < batch.size(); ++i)
+                batch[i].on_status(result[i]);
+            batch.clear();
+            paths.clear();
         }
     }
+};
 
-    void set(const std::wstring &wstring, const Platform platform = NATIVE) 
-    {
-#ifdef __unix__
+inline std::future<FileStatus> FilePath::async_status(bool follow_symlink) const
+{
+    return AsyncFileSystem::instance().status(*this, follow_symlink);
+}
 
-#else
-        std::string string;
-        if (!wstring.empty()) 
-        {
-            int size = WideCharToMultiByte(CP_UTF8, 0, &wstring[0], (int)wstring.size(), NULL, 0, NULL, NULL);
-            string.resize(size, 0);
-            WideCharToMultiByte(CP_UTF8, 0, &wstring[0], (int)wstring.size(), &string[0], size, NULL, NULL);
-        }
-        set(string, platform);
-#endif
-    }
+inline std::future<std::error_code> FilePath::async_remove() const
+{
+    return AsyncFileSystem::instance().remove(*this);
+}
 
-};
+inline std::future<std::vector<FilePath> > FilePath::async_list() const
+{
+    return AsyncFileSystem::instance().list(*this);
+}
+
+inline std::future<std::error_code> FilePath::async_copy(const FilePath& to, bool overwrite) const
+{
+    return AsyncFileSystem::instance().copy(*this, to, overwrite);
+}
 
 #endif
\ No newline at end of file
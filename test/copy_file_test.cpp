@@ -0,0 +1,100 @@
+/**
+ * @file copy_file_test.cpp
+ * @brief FilePath::copy_file() が複製元と同じファイル (自身, ハードリンク) を上書きしようとした場合に内容を失わないことの確認
+ *
+ * FILE_PATH_TEST_DIR (未設定の場合は /tmp/file_path_test) の下に作業用のファイルを作成する。
+ *
+ * ビルド例:
+ *   g++ -std=c++11 -O2 -I.. copy_file_test.cpp -lpthread -o copy_file_test && ./copy_file_test
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file_path.hpp"
+
+namespace {
+
+const char CONTENT[] = "copy_file must not truncate its own source\n";
+
+FilePath test_directory()
+{
+    const char* dir = std::getenv("FILE_PATH_TEST_DIR");
+    return FilePath(dir != NULL ? dir : "/tmp/file_path_test");
+}
+
+void write_file(const FilePath& path, const std::string& content)
+{
+    std::ofstream os(path.c_str(), std::ios::binary | std::ios::trunc);
+    os << content;
+}
+
+std::string read_file(const FilePath& path)
+{
+    std::ifstream is(path.c_str(), std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+}
+
+void test_self_copy(const FilePath& dir)
+{
+    const FilePath source = dir / "self.txt";
+    write_file(source, CONTENT);
+    std::error_code ec;
+    assert(!source.copy_file(source, true, ec));
+    assert(ec.value() == EINVAL);
+    assert(read_file(source) == CONTENT);
+}
+
+void test_hard_link_copy(const FilePath& dir)
+{
+    const FilePath source = dir / "link_source.txt";
+    const FilePath link = dir / "link_target.txt";
+    write_file(source, CONTENT);
+    unlink(link.c_str());
+    assert(::link(source.c_str(), link.c_str()) == 0);
+    std::error_code ec;
+    assert(!source.copy_file(link, true, ec));
+    assert(ec.value() == EINVAL);
+    assert(read_file(source) == CONTENT);
+    assert(link.exists());
+}
+
+void test_overwrite(const FilePath& dir)
+{
+    const FilePath source = dir / "overwrite_source.txt";
+    const FilePath target = dir / "overwrite_target.txt";
+    write_file(source, CONTENT);
+    write_file(target, std::string(4096, 'x'));
+    chmod(source.c_str(), 0640);
+    chmod(target.c_str(), 0600);
+    assert(source.copy_file(target, true));
+    assert(read_file(target) == CONTENT);
+    struct stat st;
+    assert(stat(target.c_str(), &st) == 0 && (st.st_mode & 07777) == 0640);
+    assert(!source.copy_file(target, false));
+}
+
+} // namespace
+
+int main()
+{
+    const FilePath dir = test_directory();
+    FilePath::remove_all(dir);
+    assert(FilePath::create_directories(dir).ok());
+
+    test_self_copy(dir);
+    test_hard_link_copy(dir);
+    test_overwrite(dir);
+
+    FilePath::remove_all(dir);
+    std::cout << "copy_file_test: ok" << std::endl;
+    return 0;
+}
\ No newline at end of file
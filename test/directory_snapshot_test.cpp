@@ -0,0 +1,167 @@
+/**
+ * @file directory_snapshot_test.cpp
+ * @brief DirectorySnapshot の差分検出 (reuse_subtrees を含む) と、壊れたファイルを load() が拒否することの確認
+ *
+ * FILE_PATH_TEST_DIR (未設定の場合は /tmp/file_path_test) の下に作業用のディレクトリを作成する。
+ *
+ * ビルド例:
+ *   g++ -std=c++11 -O2 -I.. directory_snapshot_test.cpp -lpthread -o directory_snapshot_test && ./directory_snapshot_test
+ */
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "file_path.hpp"
+
+namespace {
+
+// DirectorySnapshot::save() のヘッダー (magic[8], version, platform, record_count, names_size, root_size)
+const std::size_t RECORD_COUNT_OFFSET = 16;
+const std::size_t NAMES_SIZE_OFFSET   = 24;
+const std::size_t ROOT_SIZE_OFFSET    = 32;
+const std::size_t HEADER_SIZE         = 40;
+
+FilePath test_directory()
+{
+    const char* dir = std::getenv("FILE_PATH_TEST_DIR");
+    return FilePath(dir != NULL ? dir : "/tmp/file_path_test");
+}
+
+void touch(const FilePath& path)
+{
+    std::ofstream os(path.c_str(), std::ios::binary | std::ios::trunc);
+    os << "x";
+}
+
+std::string read_file(const FilePath& path)
+{
+    std::ifstream is(path.c_str(), std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+}
+
+void write_file(const FilePath& path, const std::string& content)
+{
+    std::ofstream os(path.c_str(), std::ios::binary | std::ios::trunc);
+    os << content;
+}
+
+void put_u64(std::string& data, std::size_t offset, uint64_t value)
+{
+    std::memcpy(&data[offset], &value, sizeof(value));
+}
+
+void put_u32(std::string& data, std::size_t offset, uint32_t value)
+{
+    std::memcpy(&data[offset], &value, sizeof(value));
+}
+
+uint64_t get_u64(const std::string& data, std::size_t offset)
+{
+    uint64_t value;
+    std::memcpy(&value, &data[offset], sizeof(value));
+    return value;
+}
+
+/**
+ * @brief index 番目のレコードの先頭のオフセット
+ */
+std::size_t record_offset(const std::string& data, std::size_t index)
+{
+    const std::size_t root_size = static_cast<std::size_t>(get_u64(data, ROOT_SIZE_OFFSET));
+    return HEADER_SIZE + root_size + (8 - root_size % 8) % 8 + index * sizeof(DirectorySnapshot::Record);
+}
+
+bool loads(const FilePath& file, const std::string& data)
+{
+    write_file(file, data);
+    DirectorySnapshot snapshot;
+    return snapshot.load(file);
+}
+
+void test_reuse_subtrees_detects_deep_changes(const FilePath& dir)
+{
+    const FilePath root = dir / "tree";
+    assert(FilePath::create_directories(root / "a" / "b").ok());
+    touch(root / "a" / "file");
+    const DirectorySnapshot before = DirectorySnapshot::capture(root);
+    assert(!before.empty());
+
+    touch(root / "a" / "b" / "new");
+    SnapshotOptions options;
+    options.reuse_subtrees = true;
+    const DirectorySnapshot added = DirectorySnapshot::capture(root, &before, options);
+    assert(DirectorySnapshot::diff(before, added).size() == 1);
+    assert(added.find(root / "a" / "b" / "new") != DirectorySnapshot::INVALID);
+    assert(added.find(root / "a" / "file") != DirectorySnapshot::INVALID);
+
+    assert((root / "a" / "b" / "new").remove_file());
+    const DirectorySnapshot removed = DirectorySnapshot::capture(root, &added, options);
+    assert(DirectorySnapshot::diff(added, removed).size() == 1);
+    assert(DirectorySnapshot::diff(before, removed).empty());
+}
+
+void test_load_rejects_corruption(const FilePath& dir)
+{
+    const FilePath root = dir / "tree";
+    const FilePath file = dir / "snapshot.bin";
+    const DirectorySnapshot snapshot = DirectorySnapshot::capture(root);
+    assert(snapshot.save(file));
+    const std::string valid = read_file(file);
+
+    DirectorySnapshot loaded;
+    assert(loaded.load(file) && loaded.size() == snapshot.size());
+    assert(DirectorySnapshot::diff(snapshot, loaded).empty());
+
+    // 途中で切れたファイル
+    assert(!loads(file, valid.substr(0, HEADER_SIZE - 1)));
+    assert(!loads(file, valid.substr(0, valid.size() - 1)));
+
+    // 乗算や加算が桁あふれしてファイルサイズと一致してしまうヘッダー
+    std::string data = valid;
+    put_u64(data, RECORD_COUNT_OFFSET, get_u64(valid, RECORD_COUNT_OFFSET) + (uint64_t(1) << 60));
+    assert(!loads(file, data));
+    data = valid;
+    put_u64(data, ROOT_SIZE_OFFSET, ~uint64_t(0) - 7);
+    assert(!loads(file, data));
+    data = valid;
+    put_u64(data, NAMES_SIZE_OFFSET, get_u64(valid, NAMES_SIZE_OFFSET) - uint64_t(sizeof(DirectorySnapshot::Record)));
+    assert(!loads(file, data));
+
+    // 範囲外を指す子・名前、前方を指さない親
+    data = valid;
+    put_u32(data, record_offset(data, 0) + offsetof(DirectorySnapshot::Record, child_count), static_cast<uint32_t>(snapshot.size()));
+    assert(!loads(file, data));
+    data = valid;
+    put_u32(data, record_offset(data, 0) + offsetof(DirectorySnapshot::Record, first_child), 0);
+    assert(!loads(file, data));
+    data = valid;
+    put_u32(data, record_offset(data, 1) + offsetof(DirectorySnapshot::Record, name_offset), static_cast<uint32_t>(get_u64(valid, NAMES_SIZE_OFFSET)));
+    assert(!loads(file, data));
+    data = valid;
+    put_u32(data, record_offset(data, 1) + offsetof(DirectorySnapshot::Record, parent), 1);
+    assert(!loads(file, data));
+
+    assert(loads(file, valid));
+}
+
+} // namespace
+
+int main()
+{
+    const FilePath dir = test_directory();
+    FilePath::remove_all(dir);
+    assert(FilePath::create_directories(dir).ok());
+
+    test_reuse_subtrees_detects_deep_changes(dir);
+    test_load_rejects_corruption(dir);
+
+    FilePath::remove_all(dir);
+    std::cout << "directory_snapshot_test: ok" << std::endl;
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,162 @@
+/**
+ * @file directory_walk_test.cpp
+ * @brief follow_symlinks 時の RecursiveDirectoryIterator / FilePath::walk / Glob::expand が、
+ *        循環しない複数のリンクから到達したディレクトリをそれぞれ列挙し、祖先へのリンクでは停止することの確認
+ *
+ * FILE_PATH_TEST_DIR (未設定の場合は /tmp/file_path_test) の下に作業用のディレクトリを作成する。
+ * シンボリックリンクを用いるため POSIX でのみ検査する。
+ *
+ * ビルド例:
+ *   g++ -std=c++11 -O2 -I.. directory_walk_test.cpp -lpthread -o directory_walk_test && ./directory_walk_test
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef __unix__
+#include <unistd.h>
+#endif
+
+#include "file_path.hpp"
+
+#ifdef __unix__
+
+namespace {
+
+FilePath test_directory()
+{
+    const char* dir = std::getenv("FILE_PATH_TEST_DIR");
+    return FilePath(dir != NULL ? dir : "/tmp/file_path_test");
+}
+
+void touch(const FilePath& path)
+{
+    std::ofstream os(path.c_str(), std::ios::binary | std::ios::trunc);
+    os << "x";
+}
+
+/**
+ * @brief root/real/file, root/real/up -> .. (root への循環), root/l1 -> real, root/l2 -> real を作成する
+ */
+FilePath make_tree(const FilePath& dir)
+{
+    const FilePath root = dir / "tree";
+    assert(FilePath::create_directories(root / "real").ok());
+    touch(root / "real" / "file");
+    assert(symlink("..", (root / "real" / "up").c_str()) == 0);
+    assert(symlink("real", (root / "l1").c_str()) == 0);
+    assert(symlink("real", (root / "l2").c_str()) == 0);
+    return root;
+}
+
+/**
+ * @brief follow_symlinks 時に列挙されるべきファイル (昇順)
+ */
+std::vector<FilePath> expected_files(const FilePath& root)
+{
+    std::vector<FilePath> files;
+    files.push_back(root / "l1" / "file");
+    files.push_back(root / "l2" / "file");
+    files.push_back(root / "real" / "file");
+    return files;
+}
+
+void test_recursive_directory_iterator(const FilePath& root)
+{
+    WalkOptions options;
+    options.follow_symlinks = true;
+    std::vector<FilePath> files;
+    std::size_t count = 0;
+    for (RecursiveDirectoryIterator it(root, options), last; it != last; ++it)
+    {
+        assert(++count < 100);
+        if (it->path().filename() == "file")
+            files.push_back(it->path());
+    }
+    std::sort(files.begin(), files.end());
+    assert(files == expected_files(root));
+
+    // 同じイテレータで兄弟のリンクへ戻っても、pop() 後に再び降りられる
+    files.clear();
+    for (RecursiveDirectoryIterator it(root, options), last; it != last; )
+    {
+        if (it->path().filename() == "file")
+        {
+            files.push_back(it->path());
+            it.pop();
+        }
+        else
+            ++it;
+    }
+    std::sort(files.begin(), files.end());
+    assert(files == expected_files(root));
+
+    options.follow_symlinks = false;
+    files.clear();
+    for (RecursiveDirectoryIterator it(root, options), last; it != last; ++it)
+    {
+        if (it->path().filename() == "file")
+            files.push_back(it->path());
+    }
+    assert(files.size() == 1 && files[0] == root / "real" / "file");
+}
+
+void test_walk(const FilePath& root)
+{
+    WalkOptions options;
+    options.follow_symlinks = true;
+    std::mutex mutex;
+    std::vector<FilePath> files;
+    std::size_t count = 0;
+    FilePath::walk(root, [&](const DirectoryEntry& entry, int)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        assert(++count < 100);
+        if (entry.path().filename() == "file")
+            files.push_back(entry.path());
+        return true;
+    }, options);
+    std::sort(files.begin(), files.end());
+    assert(files == expected_files(root));
+}
+
+void test_glob(const FilePath& root)
+{
+    WalkOptions options;
+    options.follow_symlinks = true;
+    assert(Glob("**/file").expand(root, options) == expected_files(root));
+
+    options.follow_symlinks = false;
+    const std::vector<FilePath> files = Glob("**/file").expand(root, options);
+    assert(files.size() == 1 && files[0] == root / "real" / "file");
+}
+
+} // namespace
+
+#endif
+
+int main()
+{
+#ifdef __unix__
+    const FilePath dir = test_directory();
+    FilePath::remove_all(dir);
+    assert(FilePath::create_directories(dir).ok());
+    const FilePath root = make_tree(dir);
+
+    test_recursive_directory_iterator(root);
+    test_walk(root);
+    test_glob(root);
+
+    FilePath::remove_all(dir);
+    std::cout << "directory_walk_test: ok" << std::endl;
+#else
+    std::cout << "directory_walk_test: skipped" << std::endl;
+#endif
+    return 0;
+}
\ No newline at end of file
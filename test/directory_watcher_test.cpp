@@ -0,0 +1,141 @@
+/**
+ * @file directory_watcher_test.cpp
+ * @brief DirectoryWatcher で入れ子のディレクトリを別々に add() / remove() しても、残った監視のイベントが届き続けることの確認
+ *
+ * FILE_PATH_TEST_DIR (未設定の場合は /tmp/file_path_test) の下に作業用のディレクトリを作成する。
+ * inotify を用いる Linux でのみ検査する。
+ *
+ * ビルド例:
+ *   g++ -std=c++11 -O2 -I.. directory_watcher_test.cpp -lpthread -o directory_watcher_test && ./directory_watcher_test
+ */
+
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "file_path.hpp"
+
+#ifdef __linux__
+
+namespace {
+
+FilePath test_directory()
+{
+    const char* dir = std::getenv("FILE_PATH_TEST_DIR");
+    return FilePath(dir != NULL ? dir : "/tmp/file_path_test");
+}
+
+void touch(const FilePath& path)
+{
+    std::ofstream os(path.c_str(), std::ios::binary | std::ios::trunc);
+    os << "x";
+}
+
+/**
+ * @brief path に対するイベントが届くか否か
+ */
+bool receives(DirectoryWatcher& watcher, const FilePath& path)
+{
+    std::vector<WatchEvent> events;
+    watcher.poll(events, 0);        // 前の操作のイベントを捨てる
+    touch(path);
+    events.clear();
+    watcher.poll(events, 200);
+    for (std::size_t i = 0; i < events.size(); ++i)
+    {
+        if (events[i].path == path)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief ディレクトリを作成し、その CREATED が届くか否か
+ */
+bool creates_directory(DirectoryWatcher& watcher, const FilePath& path)
+{
+    std::vector<WatchEvent> events;
+    watcher.poll(events, 0);
+    assert(FilePath::create_directory(path));
+    events.clear();
+    watcher.poll(events, 200);
+    for (std::size_t i = 0; i < events.size(); ++i)
+    {
+        if (events[i].type == WatchEvent::CREATED && events[i].path == path && events[i].is_directory)
+            return true;
+    }
+    return false;
+}
+
+void test_remove_nested_after_recursive(const FilePath& dir)
+{
+    const FilePath a = dir / "a";
+    const FilePath b = a / "b";
+    DirectoryWatcher watcher;
+    assert(watcher.add(a, true));
+    assert(watcher.add(b));
+    assert(watcher.size() == 2);
+    assert(watcher.remove(b));
+    assert(watcher.size() == 2);                // a の再帰的な監視が b を必要としている
+    assert(receives(watcher, b / "f1"));
+    assert(watcher.remove(a));
+    assert(watcher.size() == 0);
+}
+
+void test_remove_recursive_after_nested(const FilePath& dir)
+{
+    const FilePath a = dir / "a";
+    const FilePath b = a / "b";
+    DirectoryWatcher watcher;
+    assert(watcher.add(b));
+    assert(watcher.add(a, true));
+    assert(watcher.remove(a));
+    assert(watcher.size() == 1);                // b 自身の add() が残る
+    assert(receives(watcher, b / "f2"));
+    assert(!receives(watcher, a / "f3"));
+    assert(!watcher.remove(a));
+    assert(watcher.remove(b));
+    assert(watcher.size() == 0);
+}
+
+void test_recursive_flag_per_owner(const FilePath& dir)
+{
+    const FilePath a = dir / "a";
+    const FilePath b = a / "b";
+    DirectoryWatcher watcher;
+    assert(watcher.add(b));
+    assert(watcher.add(a, true));
+    assert(watcher.add(b));                     // 非再帰の add() を重ねても a による再帰は保たれる
+    assert(creates_directory(watcher, b / "new"));
+    assert(watcher.size() == 3);
+    assert(watcher.remove(a));
+    assert(watcher.size() == 1);                // a の再帰で追加した b/new は解除され、b 自身の add() は再帰にならない
+    assert(!receives(watcher, b / "new" / "f4"));
+    assert(watcher.remove(b));
+}
+
+} // namespace
+
+#endif
+
+int main()
+{
+#ifdef __linux__
+    const FilePath dir = test_directory();
+    FilePath::remove_all(dir);
+    assert(FilePath::create_directories(dir / "a" / "b").ok());
+
+    test_remove_nested_after_recursive(dir);
+    test_remove_recursive_after_nested(dir);
+    test_recursive_flag_per_owner(dir);
+
+    FilePath::remove_all(dir);
+    std::cout << "directory_watcher_test: ok" << std::endl;
+#else
+    std::cout << "directory_watcher_test: skipped" << std::endl;
+#endif
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,163 @@
+/**
+ * @file glob_test.cpp
+ * @brief Glob::match() の各記法と、Glob::expand() が一致するパスだけを昇順に列挙することの確認
+ *
+ * FILE_PATH_TEST_DIR (未設定の場合は /tmp/file_path_test) の下に作業用のディレクトリを作成する。
+ *
+ * ビルド例:
+ *   g++ -std=c++11 -O2 -I.. glob_test.cpp -lpthread -o glob_test && ./glob_test
+ */
+
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "file_path.hpp"
+
+namespace {
+
+FilePath test_directory()
+{
+    const char* dir = std::getenv("FILE_PATH_TEST_DIR");
+    return FilePath(dir != NULL ? dir : "/tmp/file_path_test");
+}
+
+void touch(const FilePath& path)
+{
+    std::ofstream os(path.c_str(), std::ios::binary | std::ios::trunc);
+    os << "x";
+}
+
+bool matches(const std::string& pattern, const std::string& path)
+{
+    return Glob(pattern, FilePath::UNIX).match(FilePathView(path, FilePath::UNIX));
+}
+
+bool windows_matches(const std::string& pattern, const std::string& path)
+{
+    return Glob(pattern, FilePath::WINDOWS).match(FilePathView(path, FilePath::WINDOWS));
+}
+
+void test_match_wildcards()
+{
+    assert(matches("*.log", "a.log"));
+    assert(matches("*.log", ".log"));
+    assert(!matches("*.log", "a.txt"));
+    assert(!matches("*.log", "dir/a.log"));            // '*' は区切り文字に一致しない
+    assert(matches("a*b*c", "aXXbYYc"));
+    assert(matches("a*b*c", "abc"));
+    assert(!matches("a*b*c", "aXXbYY"));
+    assert(matches("?.txt", "a.txt"));
+    assert(!matches("?.txt", "ab.txt"));
+    assert(matches("[abc].txt", "b.txt"));
+    assert(!matches("[abc].txt", "d.txt"));
+    assert(matches("[a-c]x", "cx"));
+    assert(!matches("[a-c]x", "dx"));
+    assert(matches("[!a-c]x", "dx"));
+    assert(!matches("[!a-c]x", "ax"));
+    assert(matches("\\*", "*"));
+    assert(!matches("\\*", "a"));
+    assert(matches("lit", "lit"));
+    assert(!matches("lit", "literal"));
+}
+
+void test_match_recursive()
+{
+    assert(matches("**/*.log", "a.log"));
+    assert(matches("**/*.log", "x/y/a.log"));
+    assert(!matches("**/*.log", "x/y/a.txt"));
+    assert(matches("a/**/b", "a/b"));
+    assert(matches("a/**/b", "a/x/y/b"));
+    assert(!matches("a/**/b", "a/x/y/c"));
+    assert(matches("a/**", "a"));
+    assert(matches("a/**", "a/x/y"));
+    assert(matches("**/x/**/y", "p/x/q/x/r/y"));
+    assert(!matches("**/x/**/y", "p/y/x"));
+
+    // 絶対パターンはルートも一致する必要がある
+    assert(matches("/usr/*/lib", "/usr/local/lib"));
+    assert(!matches("/usr/*/lib", "usr/local/lib"));
+    assert(!matches("usr/*/lib", "/usr/local/lib"));
+
+    assert(Glob("C:\\**\\*.dll", FilePath::WINDOWS).is_absolute());
+    assert(windows_matches("C:\\**\\*.dll", "C:\\Windows\\System32\\a.dll"));
+    assert(windows_matches("C:\\**\\*.dll", "C:/a.dll"));
+    assert(!windows_matches("C:\\**\\*.dll", "D:\\a.dll"));
+    assert(windows_matches("C:\\**\\*.dll", "c:\\a.dll"));
+    assert(!windows_matches("/**/*.dll", "C:\\a.dll"));
+}
+
+void test_properties()
+{
+    const Glob literal("a/b/c", FilePath::UNIX);
+    assert(literal.is_literal() && !literal.is_absolute() && literal.size() == 3);
+    const Glob pattern("a/*.log", FilePath::UNIX);
+    assert(!pattern.is_literal());
+    assert(pattern.match_component(0, FilePathView("a")));
+    assert(pattern.match_component(1, FilePathView("x.log")));
+    assert(!pattern.match_component(1, FilePathView("x.txt")));
+    assert(!pattern.match_component(2, FilePathView("x.log")));
+}
+
+void test_expand(const FilePath& dir)
+{
+    const FilePath root = dir / "glob";
+    assert(FilePath::create_directories(root / "src" / "sub").ok());
+    assert(FilePath::create_directories(root / "doc").ok());
+    touch(root / "a.log");
+    touch(root / "b.txt");
+    touch(root / "src" / "c.log");
+    touch(root / "src" / "sub" / "d.log");
+    touch(root / "doc" / "e.txt");
+
+    std::vector<FilePath> expected;
+    expected.push_back(root / "a.log");
+    expected.push_back(root / "src" / "c.log");
+    expected.push_back(root / "src" / "sub" / "d.log");
+    assert(Glob("**/*.log").expand(root) == expected);
+
+    expected.clear();
+    expected.push_back(root / "a.log");
+    assert(Glob("*.log").expand(root) == expected);
+
+    expected.clear();
+    expected.push_back(root / "src" / "sub" / "d.log");
+    assert(Glob("src/sub/d.log").expand(root) == expected);
+    assert(Glob("src/missing/d.log").expand(root).empty());
+
+    expected.clear();
+    expected.push_back(root / "doc");
+    expected.push_back(root / "src");
+    assert(Glob("[ds]*").expand(root) == expected);
+
+    expected.clear();
+    expected.push_back(root / "doc" / "e.txt");
+    expected.push_back(root / "src" / "sub");
+    assert(Glob("?*/[!c]*").expand(root) == expected);
+
+    // 絶対パターンは base を無視する
+    expected.clear();
+    expected.push_back(root / "src" / "c.log");
+    assert(Glob((root / "s*" / "*.log").to_str()).expand(FilePath("/nonexistent")) == expected);
+}
+
+} // namespace
+
+int main()
+{
+    test_match_wildcards();
+    test_match_recursive();
+    test_properties();
+
+    const FilePath dir = test_directory();
+    FilePath::remove_all(dir);
+    assert(FilePath::create_directories(dir).ok());
+    test_expand(dir);
+    FilePath::remove_all(dir);
+
+    std::cout << "glob_test: ok" << std::endl;
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+/**
+ * @file lexical_path_test.cpp
+ * @brief lexically_normal() / lexically_relative() / lexically_proximate() / parent_path() の文字列上の結果の確認
+ *
+ * 末尾の区切り文字を保持しない点を除き、std::filesystem::path の同名の関数と同じ結果になることを確かめる。
+ * システムコールは行わないため、作業用のディレクトリは作成しない。
+ *
+ * ビルド例:
+ *   g++ -std=c++11 -O2 -I.. lexical_path_test.cpp -lpthread -o lexical_path_test && ./lexical_path_test
+ */
+
+#include <cassert>
+#include <iostream>
+#include <string>
+
+#include "file_path.hpp"
+
+namespace {
+
+std::string normal(const std::string& path)
+{
+    return FilePath(FilePathView(path, FilePath::UNIX)).lexically_normal().to_str(FilePath::UNIX);
+}
+
+std::string relative(const std::string& path, const std::string& base)
+{
+    return FilePath(FilePathView(path, FilePath::UNIX)).lexically_relative(FilePath(FilePathView(base, FilePath::UNIX))).to_str(FilePath::UNIX);
+}
+
+std::string proximate(const std::string& path, const std::string& base)
+{
+    return FilePath(FilePathView(path, FilePath::UNIX)).lexically_proximate(FilePath(FilePathView(base, FilePath::UNIX))).to_str(FilePath::UNIX);
+}
+
+std::string parent(const std::string& path)
+{
+    return FilePath(FilePathView(path, FilePath::UNIX)).parent_path().to_str(FilePath::UNIX);
+}
+
+FilePath windows(const std::string& path)
+{
+    return FilePath(FilePathView(path, FilePath::WINDOWS));
+}
+
+void test_lexically_normal()
+{
+    assert(normal("a/./b/../c") == "a/c");
+    assert(normal("a//b///c/") == "a/b/c");
+    assert(normal("a/b/.") == "a/b");
+    assert(normal("x/../../y") == "../y");
+    assert(normal("../a/../..") == "../..");
+    assert(normal("a/b/../../..") == "..");
+    assert(normal("a/..") == ".");
+    assert(normal("./") == ".");
+    assert(normal(".") == ".");
+    assert(normal("..") == "..");
+    assert(normal("") == "");
+
+    // ルートより上を指す ".." は取り除く
+    assert(normal("/../a") == "/a");
+    assert(normal("/a/b/../../..") == "/");
+    assert(normal("/.") == "/");
+    assert(normal("/") == "/");
+
+    assert(windows("C:\\a\\..\\b\\.\\c").lexically_normal().to_str(FilePath::WINDOWS) == "C:\\b\\c");
+    assert(windows("C:/..").lexically_normal().to_str(FilePath::WINDOWS) == "C:\\");
+    assert(windows("a\\..\\..").lexically_normal().to_str(FilePath::WINDOWS) == "..");
+}
+
+void test_lexically_relative()
+{
+    assert(relative("/a/d", "/a/b/c") == "../../d");
+    assert(relative("a/b/c", "a") == "b/c");
+    assert(relative("a/b/c", "a/x/y") == "../../b/c");
+    assert(relative("a", "a") == ".");
+    assert(relative("/", "/") == ".");
+    assert(relative("/a", "/") == "a");
+    assert(relative("a", "a/b/..") == ".");
+    assert(relative("a/b", "a/b/c/..") == ".");
+    assert(relative("a/b", "a/./b") == "../b");
+    assert(relative("a/b", "c/..") == "a/b");
+    assert(relative("a", "../b") == "a");
+
+    // ルートが異なる場合や base が ".." で上へ出る場合は空
+    assert(relative("/a", "b") == "");
+    assert(relative("a", "/a") == "");
+    assert(relative("a", "..") == "");
+    assert(windows("C:\\a").lexically_relative(windows("D:\\a")).empty());
+    assert(windows("C:\\a\\b").lexically_relative(windows("C:\\a\\c")).to_str(FilePath::WINDOWS) == "..\\b");
+}
+
+void test_lexically_proximate()
+{
+    assert(proximate("/a/d", "/a/b/c") == "../../d");
+    assert(proximate("/a", "b") == "/a");
+    assert(proximate("a", "..") == "a");
+    assert(proximate("a", "a") == ".");
+}
+
+void test_parent_path()
+{
+    assert(parent("a/b") == "a");
+    assert(parent("a") == "");
+    assert(parent("/a") == "/");
+    assert(parent("/") == "/");
+    assert(parent("") == "..");
+    assert(parent("..") == "../..");
+    assert(parent("a/..") == "a/../..");
+    assert(parent("/a/..") == "/");
+    assert(windows("C:\\a").parent_path().to_str(FilePath::WINDOWS) == "C:\\");
+}
+
+} // namespace
+
+int main()
+{
+    test_lexically_normal();
+    test_lexically_relative();
+    test_lexically_proximate();
+    test_parent_path();
+
+    std::cout << "lexical_path_test: ok" << std::endl;
+    return 0;
+}
\ No newline at end of file
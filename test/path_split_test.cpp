@@ -0,0 +1,144 @@
+/**
+ * @file path_split_test.cpp
+ * @brief ブロック単位で区切り文字を走査する FilePath の解析と FilePathView の列挙が、
+ *        1文字ずつ分割する単純な実装と一致することを乱数で生成したパスで確認する
+ *
+ * SEPARATOR_BLOCK の境界をまたぐ長さを含むように、長さ 0 から 100 のパスを生成する。
+ * 実装はコンパイル時に選ばれるため、AVX2 / SSE2 / スカラーの各実装はそれぞれのオプションでビルドして検査する。
+ *
+ * ビルド例:
+ *   g++ -std=c++11 -O2 -I.. path_split_test.cpp -lpthread -o path_split_test && ./path_split_test
+ *   g++ -std=c++11 -O2 -mavx2 -I.. path_split_test.cpp -lpthread -o path_split_test && ./path_split_test
+ *   g++ -std=c++11 -O2 -U__SSE2__ -I.. path_split_test.cpp -lpthread -o path_split_test && ./path_split_test
+ */
+
+#include <cassert>
+#include <cctype>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "file_path.hpp"
+
+namespace {
+
+const std::size_t ITERATIONS = 20000;
+const std::size_t MAX_LENGTH = 100;
+
+bool is_separator(char c, FilePath::Platform platform)
+{
+    return c == '/' || (platform == FilePath::WINDOWS && c == '\\');
+}
+
+/**
+ * @brief ルートの長さ ("/" または "C:\\" 、相対パスは 0)
+ */
+std::size_t root_length(const std::string& str, FilePath::Platform platform)
+{
+    if (platform == FilePath::WINDOWS)
+        return (str.size() >= 3 && std::isalpha(static_cast<unsigned char>(str[0])) && str[1] == ':' && is_separator(str[2], platform)) ? 3 : 0;
+    return (!str.empty() && str[0] == '/') ? 1 : 0;
+}
+
+/**
+ * @brief ルートを除いた空でないコンポーネント
+ */
+std::vector<std::string> split(const std::string& str, FilePath::Platform platform)
+{
+    std::vector<std::string> result;
+    std::string component;
+    for (std::size_t i = root_length(str, platform); i < str.size(); ++i)
+    {
+        if (!is_separator(str[i], platform))
+        {
+            component += str[i];
+            continue;
+        }
+        if (!component.empty())
+            result.push_back(component);
+        component.clear();
+    }
+    if (!component.empty())
+        result.push_back(component);
+    return result;
+}
+
+/**
+ * @brief split() の結果から FilePath が保持すべき正規形を組み立てる
+ */
+std::string join(const std::string& str, FilePath::Platform platform)
+{
+    const char separator = (platform == FilePath::WINDOWS) ? '\\' : '/';
+    std::string result;
+    if (root_length(str, platform) == 3)
+        result = str.substr(0, 2) + separator;
+    else if (root_length(str, platform) == 1)
+        result = "/";
+    const std::vector<std::string> components = split(str, platform);
+    for (std::size_t i = 0; i < components.size(); ++i)
+    {
+        if (i > 0)
+            result += separator;
+        result += components[i];
+    }
+    return result;
+}
+
+std::string random_path(std::mt19937& random)
+{
+    static const char ALPHABET[] = "ab.:/\\\\//C\xe3\x81\x82";
+    std::string result;
+    if (random() % 4 == 0)
+        result = "C:/";
+    const std::size_t length = random() % (MAX_LENGTH + 1);
+    while (result.size() < length)
+        result += ALPHABET[random() % (sizeof(ALPHABET) - 1)];
+    return result;
+}
+
+void check(const std::string& str, FilePath::Platform platform)
+{
+    const FilePathView view(str, platform);
+    const FilePath path(view);
+    const std::string expected = join(str, platform);
+    assert(path.to_str(platform) == expected);
+    assert(path.is_absolute() == (root_length(str, platform) > 0));
+    assert(path == FilePath(FilePathView(expected, platform)));
+
+    const std::vector<std::string> components = split(str, platform);
+    std::size_t i = 0;
+    for (FilePathView::const_iterator it = view.begin(), last = view.end(); it != last; ++it, ++i)
+        assert(i < components.size() && it->to_str() == components[i]);
+    assert(i == components.size());
+    assert(view.empty() == components.empty());
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937 random(20261014);
+    for (std::size_t i = 0; i < ITERATIONS; ++i)
+    {
+        const std::string str = random_path(random);
+        check(str, FilePath::UNIX);
+        check(str, FilePath::WINDOWS);
+    }
+
+    // ブロック長ちょうど・前後の長さで、区切り文字が先頭・末尾に来る場合
+    for (std::size_t length = 1; length <= 70; ++length)
+    {
+        for (std::size_t pos = 0; pos < length; ++pos)
+        {
+            std::string str(length, 'a');
+            str[pos] = '/';
+            check(str, FilePath::UNIX);
+            str[pos] = '\\';
+            check(str, FilePath::WINDOWS);
+        }
+    }
+
+    std::cout << "path_split_test: ok" << std::endl;
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+/**
+ * @file remove_all_test.cpp
+ * @brief FilePath::remove_all() の削除数と、開けないディレクトリの失敗を1件だけ数えることの確認
+ *
+ * FILE_PATH_TEST_DIR (未設定の場合は /tmp/file_path_test) の下に作業用のディレクトリを作成する。
+ * パーミッションで開けないディレクトリの検査は、パーミッションを無視する root では行わない。
+ *
+ * ビルド例:
+ *   g++ -std=c++11 -O2 -I.. remove_all_test.cpp -lpthread -o remove_all_test && ./remove_all_test
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#ifdef __unix__
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "file_path.hpp"
+
+namespace {
+
+FilePath test_directory()
+{
+    const char* dir = std::getenv("FILE_PATH_TEST_DIR");
+    return FilePath(dir != NULL ? dir : "/tmp/file_path_test");
+}
+
+void touch(const FilePath& path)
+{
+    std::ofstream os(path.c_str(), std::ios::binary | std::ios::trunc);
+    os << "x";
+}
+
+void test_remove_tree(const FilePath& dir)
+{
+    const FilePath root = dir / "tree";
+    assert(FilePath::create_directories(root / "a" / "b").ok());
+    assert(FilePath::create_directories(root / "c").ok());
+    touch(root / "a" / "f1");
+    touch(root / "a" / "b" / "f2");
+    touch(root / "f3");
+
+    const FileOperationResult result = FilePath::remove_all(root);
+    assert(result.ok());
+    assert(result.count == 7);
+    assert(!root.exists());
+    assert(FilePath::remove_all(root).ok() && FilePath::remove_all(root).count == 0);
+}
+
+#ifdef __unix__
+void test_unreadable_directory(const FilePath& dir)
+{
+    const FilePath root = dir / "locked_tree";
+    const FilePath locked = root / "locked";
+    assert(FilePath::create_directories(locked).ok());
+    touch(locked / "f");
+    assert(chmod(locked.c_str(), 0) == 0);
+
+    // locked は開けず空でもないため削除できない。その親 root も空にならない
+    const FileOperationResult result = FilePath::remove_all(root);
+    assert(result.failures == 2);
+    assert(result.error == EACCES);
+    assert(result.error_path == locked.native());
+    assert(locked.exists());
+
+    // 開けなくても空であれば削除できる
+    assert(chmod(locked.c_str(), 0700) == 0);
+    assert((locked / "f").remove_file());
+    assert(chmod(locked.c_str(), 0) == 0);
+    const FileOperationResult empty = FilePath::remove_all(root);
+    assert(empty.ok() && empty.count == 2);
+    assert(!root.exists());
+}
+#endif
+
+} // namespace
+
+int main()
+{
+    const FilePath dir = test_directory();
+    FilePath::remove_all(dir);
+    assert(FilePath::create_directories(dir).ok());
+
+    test_remove_tree(dir);
+#ifdef __unix__
+    if (geteuid() != 0)
+        test_unreadable_directory(dir);
+    else
+        std::cout << "remove_all_test: unreadable directory skipped (root)" << std::endl;
+#endif
+
+    FilePath::remove_all(dir);
+    std::cout << "remove_all_test: ok" << std::endl;
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+/**
+ * @file status_batch_test.cpp
+ * @brief FilePath::status_batch() と StatxRing がリングの深さを超える件数でも全件を処理し、status() / symlink_status() と同じ結果を返すことの確認
+ *
+ * FILE_PATH_TEST_DIR (未設定の場合は /tmp/file_path_test) の下に作業用のファイルを作成する。
+ *
+ * ビルド例:
+ *   g++ -std=c++11 -O2 -I.. status_batch_test.cpp -lpthread -o status_batch_test && ./status_batch_test
+ */
+
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __unix__
+#include <unistd.h>
+#endif
+
+#include "file_path.hpp"
+
+namespace {
+
+// StatxRing の既定の深さ (256) を十分に超える件数
+const std::size_t FILE_COUNT = 1000;
+
+FilePath test_directory()
+{
+    const char* dir = std::getenv("FILE_PATH_TEST_DIR");
+    return FilePath(dir != NULL ? dir : "/tmp/file_path_test");
+}
+
+void write_file(const FilePath& path, const std::string& content)
+{
+    std::ofstream os(path.c_str(), std::ios::binary | std::ios::trunc);
+    os << content;
+}
+
+bool same(const FileStatus& a, const FileStatus& b)
+{
+    return a.type() == b.type() && a.size() == b.size() && a.mtime() == b.mtime()
+        && a.permissions() == b.permissions() && a.inode() == b.inode() && a.device() == b.device();
+}
+
+std::vector<FilePath> make_paths(const FilePath& dir)
+{
+    std::vector<FilePath> paths;
+    for (std::size_t i = 0; i < FILE_COUNT; ++i)
+    {
+        std::ostringstream name;
+        name << "file" << i;
+        const FilePath path = dir / name.str();
+        write_file(path, std::string(i % 7, 'x'));
+        paths.push_back(path);
+    }
+    paths.push_back(dir);
+    paths.push_back(dir / "missing");
+    paths.push_back(dir / "file0" / "not_a_directory");
+#ifdef __unix__
+    const FilePath link = dir / "link";
+    assert(symlink("file1", link.c_str()) == 0);
+    paths.push_back(link);
+#endif
+    return paths;
+}
+
+void test_status_batch(const std::vector<FilePath>& paths, bool follow_symlink)
+{
+    const std::vector<FileStatus> result = FilePath::status_batch(paths, follow_symlink);
+    assert(result.size() == paths.size());
+    for (std::size_t i = 0; i < paths.size(); ++i)
+        assert(same(result[i], follow_symlink ? paths[i].status() : paths[i].symlink_status()));
+}
+
+#ifdef FILE_PATH_HAS_IO_URING
+void test_small_ring(const std::vector<FilePath>& paths)
+{
+    // 深さ 4 のリングでスロットを何度も使い回す
+    StatxRing ring(4);
+    if (!ring.is_open())
+        return;                 // io_uring が使えない環境
+    std::vector<FileStatus> result(paths.size());
+    assert(ring.run(paths, true, result));
+    for (std::size_t i = 0; i < paths.size(); ++i)
+        assert(same(result[i], paths[i].status()));
+}
+#endif
+
+} // namespace
+
+int main()
+{
+    const FilePath dir = test_directory();
+    FilePath::remove_all(dir);
+    assert(FilePath::create_directories(dir).ok());
+
+    const std::vector<FilePath> paths = make_paths(dir);
+    test_status_batch(paths, true);
+    test_status_batch(paths, false);
+    assert(FilePath::status_batch(std::vector<FilePath>()).empty());
+#ifdef FILE_PATH_HAS_IO_URING
+    test_small_ring(paths);
+#endif
+
+    FilePath::remove_all(dir);
+    std::cout << "status_batch_test: ok" << std::endl;
+    return 0;
+}
\ No newline at end of file